@@ -0,0 +1,18 @@
+#pragma once
+
+namespace ThreadSafeStructs
+{
+#if defined(__cpp_lib_hardware_interference_size) && !defined(__GNUC__)
+	const size_t CACHE_LINE_SIZE = std::hardware_destructive_interference_size;
+#else
+	// GCC reports the value per -mtune and warns against it in headers, 64 holds for x86 and most ARM
+	const size_t CACHE_LINE_SIZE = 64;
+#endif
+
+	// Gives a type its own cache lines, so neighbours in an array never share one.
+	template<typename T>
+	struct alignas(CACHE_LINE_SIZE) CacheLinePadded : T
+	{
+		using T::T;
+	};
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include "SegmentedStorage.h"
+#include "PersistentStorage.h"
+
+namespace ThreadSafeStructs
+{
+	template<typename Container, typename = void>
+	struct HasReserve : std::false_type
+	{
+	};
+
+	template<typename Container>
+	struct HasReserve<Container, std::void_t<decltype(std::declval<Container&>().reserve(size_t()))>> : std::true_type
+	{
+	};
+
+	template<typename Container, typename = void>
+	struct HasShrinkToFit : std::false_type
+	{
+	};
+
+	template<typename Container>
+	struct HasShrinkToFit<Container, std::void_t<decltype(std::declval<Container&>().shrink_to_fit())>> : std::true_type
+	{
+	};
+
+	template<typename Container, typename = void>
+	struct HasCapacity : std::false_type
+	{
+	};
+
+	template<typename Container>
+	struct HasCapacity<Container, std::void_t<decltype(std::declval<const Container&>().capacity())>> : std::true_type
+	{
+	};
+
+	// Snapshot for containers which can not share their items, copies them into a persistent list.
+	template<typename Container>
+	StackSnapshot<typename Container::value_type> CopyToSnapshot(const Container& container);
+
+	// What RWLockStack needs from its backing container beyond the std::stack surface
+	// (back/push_back/pop_back/empty/size/clear). The primary template works for sequence
+	// containers such as std::vector, std::deque and boost::container::small_vector, operations a
+	// container lacks degrade to no-ops (std::deque::reserve) or estimates (std::deque capacity).
+	template<typename Container>
+	struct ContainerTraits
+	{
+		using value_type = typename Container::value_type;
+
+		// Puts all items of source on top of target keeping their order, source is left empty.
+		static void Splice(Container& target, Container&& source)
+		{
+			// taking over the source buffer is O(1), unless it would throw away a bigger reserved one
+			if (target.empty() && Capacity(target) < source.size())
+			{
+				target = std::move(source);
+			}
+			else
+			{
+				target.insert(target.end(), std::make_move_iterator(source.begin()), std::make_move_iterator(source.end()));
+			}
+			source.clear();
+		}
+
+		static void Reserve(Container& container, const size_t itemsCount)
+		{
+			if constexpr (HasReserve<Container>::value)
+			{
+				container.reserve(itemsCount);
+			}
+		}
+
+		static void ShrinkToFit(Container& container)
+		{
+			if constexpr (HasShrinkToFit<Container>::value)
+			{
+				container.shrink_to_fit();
+			}
+		}
+
+		static size_t Capacity(const Container& container) noexcept
+		{
+			if constexpr (HasCapacity<Container>::value)
+			{
+				return container.capacity();
+			}
+			else
+			{
+				return container.size();
+			}
+		}
+
+		static size_t MemoryUsage(const Container& container) noexcept
+		{
+			return sizeof(Container) + Capacity(container) * sizeof(value_type);
+		}
+
+		template<typename Function>
+		static void ForEachFromBottom(const Container& container, Function&& function)
+		{
+			for (const auto& item : container)
+			{
+				function(item);
+			}
+		}
+
+		template<typename Function>
+		static void ForEachFromTop(const Container& container, size_t maxCount, Function&& function)
+		{
+			for (auto item = container.rbegin(); item != container.rend() && maxCount > 0; ++item, --maxCount)
+			{
+				function(*item);
+			}
+		}
+
+		static StackSnapshot<value_type> Snapshot(const Container& container)
+		{
+			return CopyToSnapshot(container);
+		}
+	};
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	struct ContainerTraits<SegmentedStorage<T, ChunkCapacity, Allocator>>
+	{
+		using Container = SegmentedStorage<T, ChunkCapacity, Allocator>;
+		using value_type = T;
+
+		static void Splice(Container& target, Container&& source) noexcept
+		{
+			target.Splice(std::move(source));
+		}
+
+		static void Reserve(Container& container, const size_t itemsCount)
+		{
+			container.Reserve(itemsCount);
+		}
+
+		static void ShrinkToFit(Container& container) noexcept
+		{
+			container.ShrinkToFit();
+		}
+
+		static size_t Capacity(const Container& container) noexcept
+		{
+			return container.Capacity();
+		}
+
+		static size_t MemoryUsage(const Container& container) noexcept
+		{
+			return container.MemoryUsage();
+		}
+
+		template<typename Function>
+		static void ForEachFromBottom(const Container& container, Function&& function)
+		{
+			container.ForEachFromBottom(std::forward<Function>(function));
+		}
+
+		template<typename Function>
+		static void ForEachFromTop(const Container& container, const size_t maxCount, Function&& function)
+		{
+			container.ForEachFromTop(maxCount, std::forward<Function>(function));
+		}
+
+		static StackSnapshot<T> Snapshot(const Container& container)
+		{
+			return CopyToSnapshot(container);
+		}
+	};
+
+	template<typename T>
+	struct ContainerTraits<PersistentStorage<T>>
+	{
+		using Container = PersistentStorage<T>;
+		using value_type = T;
+
+		// nodes of source may be shared with its snapshots, so its items are copied on top of target
+		static void Splice(Container& target, Container&& source)
+		{
+			if (target.empty())
+			{
+				target.swap(source);
+				return;
+			}
+			source.ForEachFromBottom([&target](const T& item) { target.push_back(item); });
+			source.clear();
+		}
+
+		static void Reserve(Container&, const size_t)
+		{
+		}
+
+		static void ShrinkToFit(Container&)
+		{
+		}
+
+		static size_t Capacity(const Container& container) noexcept
+		{
+			return container.size();
+		}
+
+		// counts every node even if some of them are shared with snapshots
+		static size_t MemoryUsage(const Container& container) noexcept
+		{
+			return sizeof(Container) + container.size() * sizeof(PersistentStorageDetails::Node<T>);
+		}
+
+		template<typename Function>
+		static void ForEachFromBottom(const Container& container, Function&& function)
+		{
+			container.ForEachFromBottom(std::forward<Function>(function));
+		}
+
+		template<typename Function>
+		static void ForEachFromTop(const Container& container, const size_t maxCount, Function&& function)
+		{
+			container.ForEachFromTop(maxCount, std::forward<Function>(function));
+		}
+
+		static StackSnapshot<T> Snapshot(const Container& container) noexcept
+		{
+			return container.Snapshot();
+		}
+	};
+
+	template<typename Container>
+	StackSnapshot<typename Container::value_type> CopyToSnapshot(const Container& container)
+	{
+		PersistentStorage<typename Container::value_type> storage;
+		ContainerTraits<Container>::ForEachFromBottom(container, [&storage](const typename Container::value_type& item)
+			{
+				storage.push_back(item);
+			});
+		return storage.Snapshot();
+	}
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include "SpinWait.h"
+#include "CacheLine.h"
+
+namespace ThreadSafeStructs
+{
+	// Exchanger slots which let a contended Push hand its item straight to a contended
+	// TryPop. A pusher publishes an offer in a random slot and spins for a short backoff,
+	// a popper claims a published offer and moves the item out of it.
+	enum OfferState : uint8_t
+	{
+		OFFER_PUBLISHED,
+		OFFER_TAKEN,
+		// the popper's move of the item threw, the pusher keeps it
+		OFFER_REJECTED
+	};
+
+	template<typename T, uint32_t SlotsCount = 8>
+	class EliminationArray
+	{
+	public:
+		struct Offer
+		{
+			explicit Offer(T* item) noexcept
+				: item(item),
+				state(OFFER_PUBLISHED)
+			{
+			}
+
+			T* item;
+			std::atomic<OfferState> state;
+		};
+
+		EliminationArray() noexcept;
+		EliminationArray(const EliminationArray&) = delete;
+		EliminationArray& operator=(const EliminationArray&) = delete;
+
+		// Returns true if a popper took the item (it is moved from then).
+		bool TryHandOff(T& item);
+		// Returns a claimed offer or nullptr, a claimed offer must be passed to Take.
+		Offer* TryClaim() noexcept;
+		// Releases the pusher whether the move of the item succeeds or throws.
+		static T Take(Offer* offer);
+
+	private:
+		static const uint32_t BACKOFF_SPINS = 128;
+
+		static uint32_t GetRandomSlotIndex() noexcept;
+
+		// one slot per cache line, otherwise all exchangers fight for the same line
+		struct alignas(CACHE_LINE_SIZE) Slot
+		{
+			std::atomic<Offer*> offer;
+		};
+
+		Slot slots[SlotsCount];
+	};
+
+	template<typename T, uint32_t SlotsCount>
+	EliminationArray<T, SlotsCount>::EliminationArray() noexcept
+	{
+		for (auto& slot : slots)
+		{
+			slot.offer.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	template<typename T, uint32_t SlotsCount>
+	bool EliminationArray<T, SlotsCount>::TryHandOff(T& item)
+	{
+		Offer offer(&item);
+		auto& slot = slots[GetRandomSlotIndex()];
+
+		Offer* expected = nullptr;
+		if (!slot.offer.compare_exchange_strong(expected, &offer, std::memory_order_release, std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		for (uint32_t spin = 0; spin < BACKOFF_SPINS; ++spin)
+		{
+			const auto state = offer.state.load(std::memory_order_acquire);
+			if (state != OFFER_PUBLISHED)
+			{
+				return state == OFFER_TAKEN;
+			}
+			CpuRelax();
+		}
+
+		expected = &offer;
+		if (slot.offer.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		// a popper already claimed the offer, it lives on our stack until the popper is done
+		auto state = offer.state.load(std::memory_order_acquire);
+		while (state == OFFER_PUBLISHED)
+		{
+			CpuRelax();
+			state = offer.state.load(std::memory_order_acquire);
+		}
+		return state == OFFER_TAKEN;
+	}
+
+	template<typename T, uint32_t SlotsCount>
+	typename EliminationArray<T, SlotsCount>::Offer* EliminationArray<T, SlotsCount>::TryClaim() noexcept
+	{
+		auto& slot = slots[GetRandomSlotIndex()];
+		auto offer = slot.offer.load(std::memory_order_acquire);
+		if (offer && slot.offer.compare_exchange_strong(offer, nullptr, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			return offer;
+		}
+		return nullptr;
+	}
+
+	template<typename T, uint32_t SlotsCount>
+	T EliminationArray<T, SlotsCount>::Take(Offer* offer)
+	{
+		// publishes the state on every way out, a throwing move must not leave the pusher spinning
+		struct OfferRelease
+		{
+			~OfferRelease()
+			{
+				offer->state.store(state, std::memory_order_release);
+			}
+
+			Offer* offer;
+			OfferState state;
+		};
+
+		OfferRelease release{ offer, OFFER_REJECTED };
+		T dataItem(std::move(*offer->item));
+		release.state = OFFER_TAKEN;
+		return dataItem;
+	}
+
+	template<typename T, uint32_t SlotsCount>
+	uint32_t EliminationArray<T, SlotsCount>::GetRandomSlotIndex() noexcept
+	{
+		// xorshift, seeded per thread so exchangers spread over the slots
+		thread_local static uint32_t state = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state % SlotsCount;
+	}
+}
@@ -0,0 +1,277 @@
+#pragma once
+#include "ThreadSafeException.h"
+#include "SegmentedStorage.h"
+#include "LockPolicies.h"
+#include "SpinWait.h"
+#include "CacheLine.h"
+#include "ThreadNumber.h"
+
+namespace ThreadSafeStructs
+{
+	// Flat combining stack. A thread publishes its Push/TryPop request in a publication slot and
+	// spins on it; whichever thread gets the combiner lock applies all published requests in one
+	// pass, handing pushed items straight to pops of the same pass and touching data only for the
+	// rest. The lock and data stay in the combiner's cache instead of moving with every operation.
+	template<typename T>
+	class FlatCombiningStack
+	{
+	public:
+		explicit FlatCombiningStack(const uint32_t slotsCount = std::thread::hardware_concurrency());
+		FlatCombiningStack(const FlatCombiningStack<T>& stack) = delete;
+		FlatCombiningStack<T>& operator=(const FlatCombiningStack<T>& stack) = delete;
+
+		FlatCombiningStack<T>& Push(const T& item);
+		FlatCombiningStack<T>& Push(T&& item);
+
+		T TryPop();
+		bool TryPop(T& item);
+
+		bool Empty() const noexcept;
+		uint32_t Size() const noexcept;
+
+	private:
+		enum SlotState : uint32_t
+		{
+			FREE,
+			CLAIMED,
+			PUSH_REQUESTED,
+			POP_REQUESTED,
+			DONE,
+			DONE_EMPTY,
+			FAILED
+		};
+
+		// one slot per cache line, the owner and the combiner write it in turns
+		struct alignas(CACHE_LINE_SIZE) Slot
+		{
+			std::atomic<uint32_t> state{ FREE };
+			// item to push from or pop into, lives on the requesting thread's stack
+			T* item = nullptr;
+			// written by the combiner during a pass, published through state at the end of it
+			SlotState result = DONE;
+			std::exception_ptr error;
+		};
+
+		static const uint32_t MAX_COMBINING_PASSES = 4;
+
+		// Returns false when the stack was empty for a pop request.
+		bool Execute(const SlotState request, T& item);
+		Slot& ClaimSlot() noexcept;
+		void Combine();
+		bool CombinePass();
+		void PublishResults() noexcept;
+
+		const uint32_t slotsCount;
+		std::unique_ptr<Slot[]> slots;
+		alignas(CACHE_LINE_SIZE) TTASSpinLock combinerLock;
+		// touched by the combiner only, reserved for every slot so a pass never allocates
+		std::vector<Slot*> pushRequests;
+		std::vector<Slot*> popRequests;
+		SegmentedStorage<T> data;
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> itemsCount;
+	};
+
+	template<typename T>
+	FlatCombiningStack<T>::FlatCombiningStack(const uint32_t slotsCount)
+		: slotsCount(std::max(slotsCount, 1u)),
+		slots(new Slot[std::max(slotsCount, 1u)]),
+		itemsCount(0)
+	{
+		pushRequests.reserve(this->slotsCount);
+		popRequests.reserve(this->slotsCount);
+	}
+
+	template<typename T>
+	FlatCombiningStack<T>& FlatCombiningStack<T>::Push(const T& item)
+	{
+		// copied before publishing, so the combiner only ever moves
+		T itemCopy(item);
+		Execute(PUSH_REQUESTED, itemCopy);
+		return *this;
+	}
+
+	template<typename T>
+	FlatCombiningStack<T>& FlatCombiningStack<T>::Push(T&& item)
+	{
+		Execute(PUSH_REQUESTED, item);
+		return *this;
+	}
+
+	template<typename T>
+	T FlatCombiningStack<T>::TryPop()
+	{
+		T item;
+		if (!Execute(POP_REQUESTED, item))
+		{
+			throw ThreadSafeStructs::ThreadSafetyException("Item can not be poped from stack, stack is empty.");
+		}
+		return item;
+	}
+
+	template<typename T>
+	bool FlatCombiningStack<T>::TryPop(T& item)
+	{
+		return Execute(POP_REQUESTED, item);
+	}
+
+	template<typename T>
+	bool FlatCombiningStack<T>::Empty() const noexcept
+	{
+		return itemsCount.load(std::memory_order_acquire) == 0;
+	}
+
+	template<typename T>
+	uint32_t FlatCombiningStack<T>::Size() const noexcept
+	{
+		return itemsCount.load(std::memory_order_acquire);
+	}
+
+	template<typename T>
+	bool FlatCombiningStack<T>::Execute(const SlotState request, T& item)
+	{
+		auto& slot = ClaimSlot();
+		slot.item = &item;
+		slot.state.store(request, std::memory_order_release);
+
+		SpinWait spinWait;
+		auto state = slot.state.load(std::memory_order_acquire);
+		while (state == request)
+		{
+			if (combinerLock.try_lock())
+			{
+				Combine();
+				combinerLock.unlock();
+			}
+			else
+			{
+				spinWait.SpinOnce();
+			}
+			state = slot.state.load(std::memory_order_acquire);
+		}
+
+		auto error = std::move(slot.error);
+		slot.state.store(FREE, std::memory_order_release);
+		if (state == FAILED)
+		{
+			std::rethrow_exception(error);
+		}
+		return state == DONE;
+	}
+
+	template<typename T>
+	typename FlatCombiningStack<T>::Slot& FlatCombiningStack<T>::ClaimSlot() noexcept
+	{
+		// with more threads than slots, threads which share a slot take turns on it
+		auto& slot = slots[GetCurrentThreadNumber() % slotsCount];
+		SpinWait spinWait;
+		uint32_t expected = FREE;
+		while (!slot.state.compare_exchange_weak(expected, CLAIMED, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			expected = FREE;
+			spinWait.SpinOnce();
+		}
+		return slot;
+	}
+
+	template<typename T>
+	void FlatCombiningStack<T>::Combine()
+	{
+		// requests which arrive while we combine are picked up by the next pass, a few passes
+		// save their owners a trip through the lock
+		for (uint32_t pass = 0; pass < MAX_COMBINING_PASSES && CombinePass(); ++pass)
+		{
+		}
+	}
+
+	template<typename T>
+	bool FlatCombiningStack<T>::CombinePass()
+	{
+		pushRequests.clear();
+		popRequests.clear();
+		for (uint32_t index = 0; index < slotsCount; ++index)
+		{
+			auto& slot = slots[index];
+			const auto state = slot.state.load(std::memory_order_acquire);
+			if (state == PUSH_REQUESTED)
+			{
+				pushRequests.push_back(&slot);
+			}
+			else if (state == POP_REQUESTED)
+			{
+				popRequests.push_back(&slot);
+			}
+		}
+
+		// a push and a pop of the same pass cancel out without touching data
+		const auto matchedCount = std::min(pushRequests.size(), popRequests.size());
+		for (size_t index = 0; index < matchedCount; ++index)
+		{
+			auto& pushSlot = *pushRequests[index];
+			auto& popSlot = *popRequests[index];
+			try
+			{
+				*popSlot.item = std::move(*pushSlot.item);
+				popSlot.result = DONE;
+				pushSlot.result = DONE;
+			}
+			catch (...)
+			{
+				popSlot.error = std::current_exception();
+				pushSlot.error = popSlot.error;
+				popSlot.result = FAILED;
+				pushSlot.result = FAILED;
+			}
+		}
+		for (size_t index = matchedCount; index < pushRequests.size(); ++index)
+		{
+			auto& pushSlot = *pushRequests[index];
+			try
+			{
+				data.push_back(std::move(*pushSlot.item));
+				pushSlot.result = DONE;
+			}
+			catch (...)
+			{
+				pushSlot.error = std::current_exception();
+				pushSlot.result = FAILED;
+			}
+		}
+		for (size_t index = matchedCount; index < popRequests.size(); ++index)
+		{
+			auto& popSlot = *popRequests[index];
+			if (data.empty())
+			{
+				popSlot.result = DONE_EMPTY;
+				continue;
+			}
+			try
+			{
+				*popSlot.item = std::move(data.back());
+				data.pop_back();
+				popSlot.result = DONE;
+			}
+			catch (...)
+			{
+				popSlot.error = std::current_exception();
+				popSlot.result = FAILED;
+			}
+		}
+		PublishResults();
+		return !pushRequests.empty() || !popRequests.empty();
+	}
+
+	template<typename T>
+	void FlatCombiningStack<T>::PublishResults() noexcept
+	{
+		// Size() is up to date before any requester returns
+		itemsCount.store(static_cast<uint32_t>(data.size()), std::memory_order_release);
+		for (auto slot : pushRequests)
+		{
+			slot->state.store(slot->result, std::memory_order_release);
+		}
+		for (auto slot : popRequests)
+		{
+			slot->state.store(slot->result, std::memory_order_release);
+		}
+	}
+}
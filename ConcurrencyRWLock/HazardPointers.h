@@ -0,0 +1,212 @@
+#pragma once
+#include "ThreadSafeException.h"
+
+namespace ThreadSafeStructs
+{
+	namespace HazardPointers
+	{
+		const uint32_t MAX_HAZARD_POINTERS = 128;
+		const uint32_t RECLAIM_THRESHOLD = 2 * MAX_HAZARD_POINTERS;
+
+		struct HazardPointerRecord
+		{
+			std::atomic<std::thread::id> owner;
+			std::atomic<void*> pointer;
+		};
+
+		struct RetiredPointer
+		{
+			void* pointer;
+			void (*deleter)(void*);
+		};
+
+		inline HazardPointerRecord* GetHazardPointerRecords() noexcept
+		{
+			static HazardPointerRecord records[MAX_HAZARD_POINTERS];
+			return records;
+		}
+
+		inline bool IsHazard(const void* pointer) noexcept
+		{
+			auto records = GetHazardPointerRecords();
+			for (uint32_t index = 0; index < MAX_HAZARD_POINTERS; ++index)
+			{
+				if (records[index].pointer.load() == pointer)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		class HazardPointerOwner
+		{
+		public:
+			HazardPointerOwner();
+			~HazardPointerOwner();
+			HazardPointerOwner(const HazardPointerOwner&) = delete;
+			HazardPointerOwner& operator=(const HazardPointerOwner&) = delete;
+
+			std::atomic<void*>& GetPointer() noexcept;
+
+		private:
+			HazardPointerRecord* record;
+		};
+
+		inline HazardPointerOwner::HazardPointerOwner()
+			: record(nullptr)
+		{
+			auto records = GetHazardPointerRecords();
+			for (uint32_t index = 0; index < MAX_HAZARD_POINTERS; ++index)
+			{
+				std::thread::id noOwner;
+				if (records[index].owner.compare_exchange_strong(noOwner, std::this_thread::get_id()))
+				{
+					record = &records[index];
+					break;
+				}
+			}
+			if (!record)
+			{
+				throw ThreadSafeStructs::ThreadSafetyException("No hazard pointers available, too many threads.");
+			}
+		}
+
+		inline HazardPointerOwner::~HazardPointerOwner()
+		{
+			record->pointer.store(nullptr);
+			record->owner.store(std::thread::id());
+		}
+
+		inline std::atomic<void*>& HazardPointerOwner::GetPointer() noexcept
+		{
+			return record->pointer;
+		}
+
+		inline std::atomic<void*>& GetHazardPointerForCurrentThread()
+		{
+			thread_local static HazardPointerOwner owner;
+			return owner.GetPointer();
+		}
+
+		// Pointers left by finished threads which were still hazardous at thread exit.
+		class OrphanedPointers
+		{
+		public:
+			~OrphanedPointers();
+
+			void Adopt(std::vector<RetiredPointer>& retired);
+			void MoveTo(std::vector<RetiredPointer>& retired);
+
+		private:
+			std::mutex mutex;
+			std::vector<RetiredPointer> pointers;
+		};
+
+		inline OrphanedPointers::~OrphanedPointers()
+		{
+			for (auto& retired : pointers)
+			{
+				retired.deleter(retired.pointer);
+			}
+		}
+
+		inline void OrphanedPointers::Adopt(std::vector<RetiredPointer>& retired)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			pointers.insert(pointers.end(), retired.begin(), retired.end());
+			retired.clear();
+		}
+
+		inline void OrphanedPointers::MoveTo(std::vector<RetiredPointer>& retired)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			retired.insert(retired.end(), pointers.begin(), pointers.end());
+			pointers.clear();
+		}
+
+		inline OrphanedPointers& GetOrphanedPointers()
+		{
+			static OrphanedPointers orphaned;
+			return orphaned;
+		}
+
+		class RetiredList
+		{
+		public:
+			~RetiredList();
+
+			void Retire(const RetiredPointer& retired);
+			void Reclaim();
+
+		private:
+			std::vector<RetiredPointer> pointers;
+		};
+
+		inline RetiredList::~RetiredList()
+		{
+			Reclaim();
+			if (!pointers.empty())
+			{
+				GetOrphanedPointers().Adopt(pointers);
+			}
+		}
+
+		inline void RetiredList::Retire(const RetiredPointer& retired)
+		{
+			pointers.push_back(retired);
+			if (pointers.size() >= RECLAIM_THRESHOLD)
+			{
+				Reclaim();
+			}
+		}
+
+		inline void RetiredList::Reclaim()
+		{
+			GetOrphanedPointers().MoveTo(pointers);
+
+			std::vector<void*> hazards;
+			hazards.reserve(MAX_HAZARD_POINTERS);
+			auto records = GetHazardPointerRecords();
+			for (uint32_t index = 0; index < MAX_HAZARD_POINTERS; ++index)
+			{
+				auto pointer = records[index].pointer.load();
+				if (pointer)
+				{
+					hazards.push_back(pointer);
+				}
+			}
+			std::sort(hazards.begin(), hazards.end());
+
+			auto stillHazardous = std::partition(pointers.begin(), pointers.end(),
+				[&hazards](const RetiredPointer& retired)
+				{
+					return std::binary_search(hazards.begin(), hazards.end(), retired.pointer);
+				});
+			for (auto pointer = stillHazardous; pointer != pointers.end(); ++pointer)
+			{
+				pointer->deleter(pointer->pointer);
+			}
+			pointers.erase(stillHazardous, pointers.end());
+		}
+
+		inline RetiredList& GetRetiredListForCurrentThread()
+		{
+			thread_local static RetiredList retiredList;
+			return retiredList;
+		}
+
+		// Deletes pointer right away when no thread protects it, otherwise defers deletion
+		// until a later reclaim pass finds it unprotected.
+		template<typename T>
+		void Retire(T* pointer)
+		{
+			if (!IsHazard(pointer))
+			{
+				delete pointer;
+				return;
+			}
+			GetRetiredListForCurrentThread().Retire({ pointer, [](void* retired) { delete static_cast<T*>(retired); } });
+		}
+	}
+}
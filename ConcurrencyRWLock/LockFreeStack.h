@@ -0,0 +1,153 @@
+#pragma once
+#include "ThreadSafeException.h"
+#include "HazardPointers.h"
+
+namespace ThreadSafeStructs
+{
+	// Treiber stack: Push/TryPop are a single CAS on head, popped nodes are reclaimed
+	// through hazard pointers which also rules out ABA on head.
+	template<typename T>
+	class LockFreeStack
+	{
+	public:
+		LockFreeStack() noexcept;
+		~LockFreeStack();
+		LockFreeStack(const LockFreeStack<T>& stack) = delete;
+		LockFreeStack<T>& operator=(const LockFreeStack<T>& stack) = delete;
+
+		LockFreeStack<T>& Push(const T& item);
+		LockFreeStack<T>& Push(T&& item);
+
+		T TryPop();
+		bool TryPop(T& item);
+
+		bool Empty() const noexcept;
+		uint32_t Size() const noexcept;
+
+	private:
+		struct Node
+		{
+			template<typename Item>
+			explicit Node(Item&& item)
+				: data(std::forward<Item>(item)),
+				next(nullptr)
+			{
+			}
+
+			T data;
+			Node* next;
+		};
+
+		void PushNode(Node* node) noexcept;
+		Node* PopNode();
+
+		std::atomic<Node*> head;
+		std::atomic<uint32_t> size;
+	};
+
+	template<typename T>
+	LockFreeStack<T>::LockFreeStack() noexcept
+		: head(nullptr),
+		size(0)
+	{
+	}
+
+	template<typename T>
+	LockFreeStack<T>::~LockFreeStack()
+	{
+		auto node = head.load();
+		while (node)
+		{
+			auto next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+
+	template<typename T>
+	bool LockFreeStack<T>::Empty() const noexcept
+	{
+		return head.load() == nullptr;
+	}
+
+	template<typename T>
+	uint32_t LockFreeStack<T>::Size() const noexcept
+	{
+		return size.load(std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	LockFreeStack<T>& LockFreeStack<T>::Push(const T& item)
+	{
+		PushNode(new Node(item));
+		return *this;
+	}
+
+	template<typename T>
+	LockFreeStack<T>& LockFreeStack<T>::Push(T&& item)
+	{
+		PushNode(new Node(std::move(item)));
+		return *this;
+	}
+
+	template<typename T>
+	T LockFreeStack<T>::TryPop()
+	{
+		auto node = PopNode();
+		if (!node)
+		{
+			throw ThreadSafeStructs::ThreadSafetyException("Item can not be poped from stack, stack is empty.");
+		}
+		T dataItem(std::move(node->data));
+		HazardPointers::Retire(node);
+		return dataItem;
+	}
+
+	template<typename T>
+	bool LockFreeStack<T>::TryPop(T& item)
+	{
+		auto node = PopNode();
+		if (!node)
+		{
+			return false;
+		}
+		item = std::move(node->data);
+		HazardPointers::Retire(node);
+		return true;
+	}
+
+	template<typename T>
+	void LockFreeStack<T>::PushNode(Node* node) noexcept
+	{
+		// counted before publishing so Size() never underflows on a racing pop
+		size.fetch_add(1, std::memory_order_relaxed);
+		node->next = head.load(std::memory_order_relaxed);
+		while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	template<typename T>
+	typename LockFreeStack<T>::Node* LockFreeStack<T>::PopNode()
+	{
+		auto& hazardPointer = HazardPointers::GetHazardPointerForCurrentThread();
+		auto oldHead = head.load();
+		do
+		{
+			Node* protectedHead;
+			do
+			{
+				protectedHead = oldHead;
+				hazardPointer.store(oldHead);
+				oldHead = head.load();
+			} while (oldHead != protectedHead);
+		} while (oldHead && !head.compare_exchange_strong(oldHead, oldHead->next));
+		hazardPointer.store(nullptr);
+
+		if (oldHead)
+		{
+			size.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return oldHead;
+	}
+}
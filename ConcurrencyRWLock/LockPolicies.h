@@ -0,0 +1,269 @@
+#pragma once
+#include "SpinWait.h"
+
+namespace ThreadSafeStructs
+{
+	// Lock policies for RWLockStack. A policy is any type with lock/try_lock/unlock, it is also used
+	// for readers when it has lock_shared/try_lock_shared/unlock_shared (std::shared_mutex,
+	// boost::shared_mutex), otherwise readers take it exclusively (std::mutex and the locks below).
+#ifdef THREAD_SAFE_STRUCTS_NO_BOOST
+	using DefaultLockPolicy = std::shared_mutex;
+#else
+	using DefaultLockPolicy = boost::shared_mutex;
+#endif
+
+	template<typename Lock, typename = void>
+	struct IsSharedLockable : std::false_type
+	{
+	};
+
+	template<typename Lock>
+	struct IsSharedLockable<Lock, std::void_t<
+		decltype(std::declval<Lock&>().lock_shared()),
+		decltype(std::declval<Lock&>().try_lock_shared()),
+		decltype(std::declval<Lock&>().unlock_shared())>> : std::true_type
+	{
+	};
+
+	template<typename Lock>
+	using ReadLock = std::conditional_t<IsSharedLockable<Lock>::value, std::shared_lock<Lock>, std::unique_lock<Lock>>;
+
+	// Test and test-and-set spinlock, waiters spin on a plain load so the cache line stays shared
+	// until the owner releases it. Good for a handful of threads and very short critical sections.
+	class TTASSpinLock
+	{
+	public:
+		TTASSpinLock() noexcept;
+		TTASSpinLock(const TTASSpinLock&) = delete;
+		TTASSpinLock& operator=(const TTASSpinLock&) = delete;
+
+		void lock() noexcept;
+		bool try_lock() noexcept;
+		void unlock() noexcept;
+
+	private:
+		std::atomic<bool> locked;
+	};
+
+	// FIFO spinlock, threads take a ticket and spin until it is served, so no waiter starves.
+	class TicketLock
+	{
+	public:
+		TicketLock() noexcept;
+		TicketLock(const TicketLock&) = delete;
+		TicketLock& operator=(const TicketLock&) = delete;
+
+		void lock() noexcept;
+		bool try_lock() noexcept;
+		void unlock() noexcept;
+
+	private:
+		std::atomic<uint32_t> nextTicket;
+		std::atomic<uint32_t> nowServing;
+	};
+
+	// MCS queue lock, every waiter spins on a flag in its own queue node, so a release touches only
+	// the next waiter's cache line. Nodes come from a per-thread pool because lock()/unlock() have
+	// no room to pass one in, the owner keeps its node in ownerNode until unlock.
+	class McsLock
+	{
+	public:
+		McsLock() noexcept;
+		McsLock(const McsLock&) = delete;
+		McsLock& operator=(const McsLock&) = delete;
+
+		void lock();
+		bool try_lock();
+		void unlock() noexcept;
+
+	private:
+		struct Node
+		{
+			std::atomic<Node*> next;
+			std::atomic<bool> locked;
+		};
+
+		class NodePool
+		{
+		public:
+			Node* Acquire();
+			void Release(Node* node) noexcept;
+
+		private:
+			std::vector<std::unique_ptr<Node>> nodes;
+			std::vector<Node*> freeNodes;
+		};
+
+		static NodePool& GetNodePoolForCurrentThread() noexcept;
+
+		std::atomic<Node*> tail;
+		Node* ownerNode;
+	};
+
+	// No locking at all, for single threaded phases such as filling a stack before it is shared.
+	// Blocking waits never return under this policy, nobody else can push or pop.
+	class NullLock
+	{
+	public:
+		void lock() noexcept
+		{
+		}
+
+		bool try_lock() noexcept
+		{
+			return true;
+		}
+
+		void unlock() noexcept
+		{
+		}
+	};
+
+	inline TTASSpinLock::TTASSpinLock() noexcept
+		: locked(false)
+	{
+	}
+
+	inline void TTASSpinLock::lock() noexcept
+	{
+		SpinWait spinWait;
+		while (locked.exchange(true, std::memory_order_acquire))
+		{
+			while (locked.load(std::memory_order_relaxed))
+			{
+				spinWait.SpinOnce();
+			}
+		}
+	}
+
+	inline bool TTASSpinLock::try_lock() noexcept
+	{
+		return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+	}
+
+	inline void TTASSpinLock::unlock() noexcept
+	{
+		locked.store(false, std::memory_order_release);
+	}
+
+	inline TicketLock::TicketLock() noexcept
+		: nextTicket(0),
+		nowServing(0)
+	{
+	}
+
+	inline void TicketLock::lock() noexcept
+	{
+		const auto ticket = nextTicket.fetch_add(1, std::memory_order_relaxed);
+		SpinWait spinWait;
+		while (nowServing.load(std::memory_order_acquire) != ticket)
+		{
+			spinWait.SpinOnce();
+		}
+	}
+
+	inline bool TicketLock::try_lock() noexcept
+	{
+		auto ticket = nowServing.load(std::memory_order_relaxed);
+		return nextTicket.compare_exchange_strong(ticket, ticket + 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	inline void TicketLock::unlock() noexcept
+	{
+		// only the owner writes nowServing
+		nowServing.store(nowServing.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	inline McsLock::McsLock() noexcept
+		: tail(nullptr),
+		ownerNode(nullptr)
+	{
+	}
+
+	inline void McsLock::lock()
+	{
+		auto node = GetNodePoolForCurrentThread().Acquire();
+		node->next.store(nullptr, std::memory_order_relaxed);
+		node->locked.store(true, std::memory_order_relaxed);
+
+		auto predecessor = tail.exchange(node, std::memory_order_acq_rel);
+		if (predecessor)
+		{
+			predecessor->next.store(node, std::memory_order_release);
+			SpinWait spinWait;
+			while (node->locked.load(std::memory_order_acquire))
+			{
+				spinWait.SpinOnce();
+			}
+		}
+		ownerNode = node;
+	}
+
+	inline bool McsLock::try_lock()
+	{
+		if (tail.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+		auto& nodePool = GetNodePoolForCurrentThread();
+		auto node = nodePool.Acquire();
+		node->next.store(nullptr, std::memory_order_relaxed);
+
+		Node* expected = nullptr;
+		if (!tail.compare_exchange_strong(expected, node, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			nodePool.Release(node);
+			return false;
+		}
+		ownerNode = node;
+		return true;
+	}
+
+	inline void McsLock::unlock() noexcept
+	{
+		auto node = ownerNode;
+		auto successor = node->next.load(std::memory_order_acquire);
+		if (!successor)
+		{
+			auto expected = node;
+			if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+			{
+				GetNodePoolForCurrentThread().Release(node);
+				return;
+			}
+			// a waiter swapped the tail but has not linked itself yet
+			SpinWait spinWait;
+			while (!(successor = node->next.load(std::memory_order_acquire)))
+			{
+				spinWait.SpinOnce();
+			}
+		}
+		successor->locked.store(false, std::memory_order_release);
+		GetNodePoolForCurrentThread().Release(node);
+	}
+
+	inline McsLock::Node* McsLock::NodePool::Acquire()
+	{
+		if (freeNodes.empty())
+		{
+			nodes.push_back(std::make_unique<Node>());
+			// Release must not allocate, there is always room to give every node back
+			freeNodes.reserve(nodes.size());
+			return nodes.back().get();
+		}
+		auto node = freeNodes.back();
+		freeNodes.pop_back();
+		return node;
+	}
+
+	inline void McsLock::NodePool::Release(Node* node) noexcept
+	{
+		freeNodes.push_back(node);
+	}
+
+	inline McsLock::NodePool& McsLock::GetNodePoolForCurrentThread() noexcept
+	{
+		thread_local static NodePool nodePool;
+		return nodePool;
+	}
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+namespace ThreadSafeStructs
+{
+	template<typename T>
+	class PersistentStorage;
+
+	namespace PersistentStorageDetails
+	{
+		// Immutable once linked, shared between a storage and all snapshots taken from it.
+		template<typename T>
+		struct Node
+		{
+			template<typename... Args>
+			explicit Node(std::shared_ptr<Node> next, Args&&... args)
+				: item(std::forward<Args>(args)...),
+				next(std::move(next))
+			{
+			}
+
+			// releases the chain in a loop, a recursive release would overflow the stack on long lists
+			~Node()
+			{
+				auto node = std::move(next);
+				while (node && node.use_count() == 1)
+				{
+					// use_count is a relaxed read, order it after the other owners' releases
+					std::atomic_thread_fence(std::memory_order_acquire);
+					node = std::move(node->next);
+				}
+			}
+
+			T item;
+			std::shared_ptr<Node> next;
+		};
+	}
+
+	// Read only view of a PersistentStorage as it was when the snapshot was taken. Iterates from the
+	// top of the stack to the bottom and stays valid and unchanged whatever happens to the storage.
+	template<typename T>
+	class StackSnapshot
+	{
+	public:
+		class Iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const T*;
+			using reference = const T&;
+
+			Iterator() noexcept
+				: node(nullptr)
+			{
+			}
+
+			explicit Iterator(const PersistentStorageDetails::Node<T>* node) noexcept
+				: node(node)
+			{
+			}
+
+			reference operator*() const noexcept
+			{
+				return node->item;
+			}
+
+			pointer operator->() const noexcept
+			{
+				return &node->item;
+			}
+
+			Iterator& operator++() noexcept
+			{
+				node = node->next.get();
+				return *this;
+			}
+
+			Iterator operator++(int) noexcept
+			{
+				auto previous = *this;
+				++*this;
+				return previous;
+			}
+
+			bool operator==(const Iterator& iterator) const noexcept
+			{
+				return node == iterator.node;
+			}
+
+			bool operator!=(const Iterator& iterator) const noexcept
+			{
+				return node != iterator.node;
+			}
+
+		private:
+			const PersistentStorageDetails::Node<T>* node;
+		};
+
+		StackSnapshot() noexcept;
+
+		Iterator begin() const noexcept;
+		Iterator end() const noexcept;
+
+		bool empty() const noexcept;
+		size_t size() const noexcept;
+
+	private:
+		friend class PersistentStorage<T>;
+
+		StackSnapshot(std::shared_ptr<PersistentStorageDetails::Node<T>> top, const size_t itemsCount) noexcept;
+
+		std::shared_ptr<PersistentStorageDetails::Node<T>> top;
+		size_t itemsCount;
+	};
+
+	// Stack storage made of immutable nodes shared between copies: copying the storage or taking a
+	// Snapshot is O(1) and pushing or popping never touches a node another copy can see.
+	// back() is read only because the top node may be shared, pops copy the item out.
+	template<typename T>
+	class PersistentStorage
+	{
+	public:
+		using value_type = T;
+		using size_type = size_t;
+		using reference = const T&;
+		using const_reference = const T&;
+
+		PersistentStorage() noexcept;
+
+		void push_back(const T& item);
+		void push_back(T&& item);
+		template<typename... Args>
+		void emplace_back(Args&&... args);
+		void pop_back() noexcept;
+
+		const T& back() const noexcept;
+
+		bool empty() const noexcept;
+		size_t size() const noexcept;
+		void clear() noexcept;
+		void swap(PersistentStorage& storage) noexcept;
+
+		StackSnapshot<T> Snapshot() const noexcept;
+
+		template<typename Function>
+		void ForEachFromBottom(Function&& function) const;
+		// Visits at most maxCount items starting with the top one.
+		template<typename Function>
+		void ForEachFromTop(size_t maxCount, Function&& function) const;
+
+	private:
+		using Node = PersistentStorageDetails::Node<T>;
+
+		std::shared_ptr<Node> top;
+		size_t itemsCount;
+	};
+
+	template<typename T>
+	StackSnapshot<T>::StackSnapshot() noexcept
+		: itemsCount(0)
+	{
+	}
+
+	template<typename T>
+	StackSnapshot<T>::StackSnapshot(std::shared_ptr<PersistentStorageDetails::Node<T>> top, const size_t itemsCount) noexcept
+		: top(std::move(top)),
+		itemsCount(itemsCount)
+	{
+	}
+
+	template<typename T>
+	typename StackSnapshot<T>::Iterator StackSnapshot<T>::begin() const noexcept
+	{
+		return Iterator(top.get());
+	}
+
+	template<typename T>
+	typename StackSnapshot<T>::Iterator StackSnapshot<T>::end() const noexcept
+	{
+		return Iterator();
+	}
+
+	template<typename T>
+	bool StackSnapshot<T>::empty() const noexcept
+	{
+		return itemsCount == 0;
+	}
+
+	template<typename T>
+	size_t StackSnapshot<T>::size() const noexcept
+	{
+		return itemsCount;
+	}
+
+	template<typename T>
+	PersistentStorage<T>::PersistentStorage() noexcept
+		: itemsCount(0)
+	{
+	}
+
+	template<typename T>
+	void PersistentStorage<T>::push_back(const T& item)
+	{
+		emplace_back(item);
+	}
+
+	template<typename T>
+	void PersistentStorage<T>::push_back(T&& item)
+	{
+		emplace_back(std::move(item));
+	}
+
+	template<typename T>
+	template<typename... Args>
+	void PersistentStorage<T>::emplace_back(Args&&... args)
+	{
+		top = std::make_shared<Node>(top, std::forward<Args>(args)...);
+		++itemsCount;
+	}
+
+	template<typename T>
+	void PersistentStorage<T>::pop_back() noexcept
+	{
+		top = top->next;
+		--itemsCount;
+	}
+
+	template<typename T>
+	const T& PersistentStorage<T>::back() const noexcept
+	{
+		return top->item;
+	}
+
+	template<typename T>
+	bool PersistentStorage<T>::empty() const noexcept
+	{
+		return itemsCount == 0;
+	}
+
+	template<typename T>
+	size_t PersistentStorage<T>::size() const noexcept
+	{
+		return itemsCount;
+	}
+
+	template<typename T>
+	void PersistentStorage<T>::clear() noexcept
+	{
+		top.reset();
+		itemsCount = 0;
+	}
+
+	template<typename T>
+	void PersistentStorage<T>::swap(PersistentStorage& storage) noexcept
+	{
+		std::swap(top, storage.top);
+		std::swap(itemsCount, storage.itemsCount);
+	}
+
+	template<typename T>
+	StackSnapshot<T> PersistentStorage<T>::Snapshot() const noexcept
+	{
+		return StackSnapshot<T>(top, itemsCount);
+	}
+
+	template<typename T>
+	template<typename Function>
+	void PersistentStorage<T>::ForEachFromBottom(Function&& function) const
+	{
+		std::vector<const Node*> nodes;
+		nodes.reserve(itemsCount);
+		for (auto node = top.get(); node; node = node->next.get())
+		{
+			nodes.push_back(node);
+		}
+		for (auto node = nodes.rbegin(); node != nodes.rend(); ++node)
+		{
+			function((*node)->item);
+		}
+	}
+
+	template<typename T>
+	template<typename Function>
+	void PersistentStorage<T>::ForEachFromTop(size_t maxCount, Function&& function) const
+	{
+		for (auto node = top.get(); node && maxCount > 0; node = node->next.get(), --maxCount)
+		{
+			function(node->item);
+		}
+	}
+}
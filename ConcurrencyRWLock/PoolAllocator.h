@@ -0,0 +1,227 @@
+#pragma once
+
+namespace ThreadSafeStructs
+{
+	// Thread safe pool of fixed size blocks, one per block size and alignment. Blocks are carved out of
+	// slabs which are never given back to the system. A freed block goes to a small per-thread cache
+	// and only overflows in batches to the global free list, so a thread which frees and allocates
+	// blocks at the same rate touches neither malloc nor the global mutex.
+	template<size_t BlockSize, size_t BlockAlignment>
+	class FixedBlockPool
+	{
+	public:
+		FixedBlockPool(const FixedBlockPool&) = delete;
+		FixedBlockPool& operator=(const FixedBlockPool&) = delete;
+
+		static FixedBlockPool& Instance();
+
+		void* Allocate();
+		void Deallocate(void* block) noexcept;
+
+		// Number of blocks taken from the system so far.
+		size_t AllocatedBlocksCount() const noexcept;
+
+	private:
+		struct FreeBlock
+		{
+			FreeBlock* next;
+		};
+
+		// Blocks cached by one thread, given back to the global list when the thread exits.
+		struct ThreadCache
+		{
+			~ThreadCache();
+
+			FreeBlock* blocks = nullptr;
+			uint32_t count = 0;
+		};
+
+		static const size_t BLOCK_ALIGNMENT = std::max(BlockAlignment, alignof(FreeBlock));
+		static const size_t BLOCK_BYTES = (std::max(BlockSize, sizeof(FreeBlock)) + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+		static const size_t SLAB_BYTES = 64 * 1024;
+		static const size_t BLOCKS_PER_SLAB = BLOCK_BYTES >= SLAB_BYTES / 4 ? 4 : SLAB_BYTES / BLOCK_BYTES;
+		static const uint32_t THREAD_CACHE_CAPACITY = 32;
+		static const uint32_t TRANSFER_BATCH = THREAD_CACHE_CAPACITY / 2;
+
+		FixedBlockPool() noexcept;
+
+		static ThreadCache& GetThreadCache() noexcept;
+		void RefillThreadCache(ThreadCache& cache);
+		void MoveToGlobalList(ThreadCache& cache, uint32_t blocksCount) noexcept;
+		void AllocateSlab();
+
+		std::mutex mutex;
+		FreeBlock* freeBlocks;
+		std::atomic<size_t> allocatedBlocksCount;
+	};
+
+	// Standard allocator on top of FixedBlockPool. Single object allocations come from the pool of
+	// sizeof(T) blocks, arrays go to the global allocator. Stateless, so all instances compare equal
+	// and memory may be freed through any of them, which SegmentedStorage::Splice relies on.
+	template<typename T>
+	class PoolAllocator
+	{
+	public:
+		using value_type = T;
+
+		PoolAllocator() noexcept = default;
+		template<typename U>
+		PoolAllocator(const PoolAllocator<U>&) noexcept
+		{
+		}
+
+		T* allocate(const size_t count);
+		void deallocate(T* pointer, const size_t count) noexcept;
+
+	private:
+		using Pool = FixedBlockPool<sizeof(T), alignof(T)>;
+	};
+
+	template<typename T, typename U>
+	bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept
+	{
+		return true;
+	}
+
+	template<typename T, typename U>
+	bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept
+	{
+		return false;
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	FixedBlockPool<BlockSize, BlockAlignment>::FixedBlockPool() noexcept
+		: freeBlocks(nullptr),
+		allocatedBlocksCount(0)
+	{
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	FixedBlockPool<BlockSize, BlockAlignment>& FixedBlockPool<BlockSize, BlockAlignment>::Instance()
+	{
+		// never destroyed, containers with static storage duration may still free blocks at exit
+		static auto pool = new FixedBlockPool();
+		return *pool;
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	void* FixedBlockPool<BlockSize, BlockAlignment>::Allocate()
+	{
+		auto& cache = GetThreadCache();
+		if (!cache.blocks)
+		{
+			RefillThreadCache(cache);
+		}
+		auto block = cache.blocks;
+		cache.blocks = block->next;
+		--cache.count;
+		return block;
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	void FixedBlockPool<BlockSize, BlockAlignment>::Deallocate(void* block) noexcept
+	{
+		auto& cache = GetThreadCache();
+		auto freeBlock = static_cast<FreeBlock*>(block);
+		freeBlock->next = cache.blocks;
+		cache.blocks = freeBlock;
+		++cache.count;
+		if (cache.count > THREAD_CACHE_CAPACITY)
+		{
+			MoveToGlobalList(cache, TRANSFER_BATCH);
+		}
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	size_t FixedBlockPool<BlockSize, BlockAlignment>::AllocatedBlocksCount() const noexcept
+	{
+		return allocatedBlocksCount.load(std::memory_order_relaxed);
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	FixedBlockPool<BlockSize, BlockAlignment>::ThreadCache::~ThreadCache()
+	{
+		Instance().MoveToGlobalList(*this, count);
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	typename FixedBlockPool<BlockSize, BlockAlignment>::ThreadCache& FixedBlockPool<BlockSize, BlockAlignment>::GetThreadCache() noexcept
+	{
+		thread_local static ThreadCache cache;
+		return cache;
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	void FixedBlockPool<BlockSize, BlockAlignment>::RefillThreadCache(ThreadCache& cache)
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (!freeBlocks)
+		{
+			AllocateSlab();
+		}
+		while (freeBlocks && cache.count < TRANSFER_BATCH)
+		{
+			auto block = freeBlocks;
+			freeBlocks = block->next;
+			block->next = cache.blocks;
+			cache.blocks = block;
+			++cache.count;
+		}
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	void FixedBlockPool<BlockSize, BlockAlignment>::MoveToGlobalList(ThreadCache& cache, uint32_t blocksCount) noexcept
+	{
+		if (blocksCount == 0)
+		{
+			return;
+		}
+		// unlink the batch first, so the mutex is held only for the splice
+		auto first = cache.blocks;
+		auto last = first;
+		for (uint32_t index = 1; index < blocksCount; ++index)
+		{
+			last = last->next;
+		}
+		cache.blocks = last->next;
+		cache.count -= blocksCount;
+
+		const std::lock_guard<std::mutex> lock(mutex);
+		last->next = freeBlocks;
+		freeBlocks = first;
+	}
+
+	template<size_t BlockSize, size_t BlockAlignment>
+	void FixedBlockPool<BlockSize, BlockAlignment>::AllocateSlab()
+	{
+		auto slab = static_cast<unsigned char*>(::operator new(BLOCK_BYTES * BLOCKS_PER_SLAB, std::align_val_t(BLOCK_ALIGNMENT)));
+		for (size_t index = BLOCKS_PER_SLAB; index > 0; --index)
+		{
+			auto block = reinterpret_cast<FreeBlock*>(slab + (index - 1) * BLOCK_BYTES);
+			block->next = freeBlocks;
+			freeBlocks = block;
+		}
+		allocatedBlocksCount.fetch_add(BLOCKS_PER_SLAB, std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	T* PoolAllocator<T>::allocate(const size_t count)
+	{
+		if (count != 1)
+		{
+			return std::allocator<T>().allocate(count);
+		}
+		return static_cast<T*>(Pool::Instance().Allocate());
+	}
+
+	template<typename T>
+	void PoolAllocator<T>::deallocate(T* pointer, const size_t count) noexcept
+	{
+		if (count != 1)
+		{
+			std::allocator<T>().deallocate(pointer, count);
+			return;
+		}
+		Pool::Instance().Deallocate(pointer);
+	}
+}
@@ -1,222 +1,1281 @@
 #pragma once
 #include "ThreadSafeException.h"
+#include "EliminationArray.h"
+#include "SegmentedStorage.h"
+#include "ContainerTraits.h"
+#include "LockPolicies.h"
+#include "PoolAllocator.h"
+#include "CacheLine.h"
+#include "StackStatistics.h"
+#include "StackTrace.h"
 
 namespace
 {
-	template<typename T>
-	std::vector<T> ConvertStackToVector(std::stack<T> stack)
+	// std::stack keeps its container protected, a derived accessor lets us walk it bottom to top
+	template<typename T, typename Container>
+	Container& GetStackContainer(std::stack<T, Container>& stack)
 	{
-		std::vector<int> buffer;
-
-		while (!stack.empty())
+		struct StackAccess : std::stack<T, Container>
 		{
-			buffer.push_back(stack.top());
-			stack.pop();
-		}
-		return buffer;
+			static Container& Get(std::stack<T, Container>& stack)
+			{
+				return stack.*&StackAccess::c;
+			}
+		};
+		return StackAccess::Get(stack);
 	}
 
-	template<typename T>
-	void AppendStackToStack(std::stack<T>& first, const std::stack<T>& second)
+	template<typename T, typename Container>
+	const Container& GetStackContainer(const std::stack<T, Container>& stack)
 	{
-		auto bufferSecondPart = ConvertStackToVector(second);
+		return GetStackContainer(const_cast<std::stack<T, Container>&>(stack));
+	}
 
-		for (auto pointer = bufferSecondPart.rbegin(); pointer != bufferSecondPart.rend(); ++pointer)
+	template<typename Storage, typename T>
+	Storage ConvertStackToStorage(const std::stack<T>& stack)
+	{
+		Storage storage;
+		for (const auto& item : GetStackContainer(stack))
 		{
-			first.push(*pointer);
+			storage.push_back(item);
 		}
+		return storage;
 	}
 
-	template<typename T>
-	void AppendStackToStack(std::stack<T>& first, const std::stack<T>&& second)
+	template<typename Storage, typename T>
+	Storage ConvertStackToStorage(std::stack<T>&& stack)
 	{
-		auto bufferSecondPart = ConvertStackToVector(std::move(second));
+		Storage storage;
+		for (auto& item : GetStackContainer(stack))
+		{
+			storage.push_back(std::move(item));
+		}
+		return storage;
+	}
 
-		for (auto pointer = bufferSecondPart.rbegin(); pointer != bufferSecondPart.rend(); ++pointer)
+	// Undoes ConvertStackToStorage(std::stack<T>&&), the stack still holds the moved from items.
+	template<typename Storage, typename T>
+	void MoveStorageBackToStack(Storage&& storage, std::stack<T>& stack)
+	{
+		auto& container = GetStackContainer(stack);
+		for (auto index = container.size(); !storage.empty(); storage.pop_back())
 		{
-			first.push(*pointer);
+			container[--index] = std::move(storage.back());
 		}
 	}
 }
 
 namespace ThreadSafeStructs
 {
-	template<typename T>
+	const uint32_t UNBOUNDED_CAPACITY = std::numeric_limits<uint32_t>::max();
+
+	// Bounded configuration of RWLockStack. onHighWatermark runs once the size reaches highWatermark,
+	// onLowWatermark runs when the size drops back to lowWatermark, so producers can throttle before
+	// they block on a full stack. Callbacks run after the stack lock is released.
+	struct StackCapacity
+	{
+		uint32_t capacity = UNBOUNDED_CAPACITY;
+		uint32_t highWatermark = UNBOUNDED_CAPACITY;
+		uint32_t lowWatermark = 0;
+		std::function<void()> onHighWatermark;
+		std::function<void()> onLowWatermark;
+	};
+
+	// Default executor of RWLockStack::PopAsync, resumes the coroutine on the pushing thread.
+	struct ResumeInline
+	{
+		void operator()(std::coroutine_handle<> coroutine) const
+		{
+			coroutine.resume();
+		}
+	};
+
+	// LockPolicy is the mutex guarding the stack, see LockPolicies.h. Reader-writer policies let copies
+	// and exports run next to each other, spinlocks suit short critical sections under low contention.
+	// Wrapping any of them in InstrumentedLock (StackStatistics.h) turns on Stats(), wrapping in
+	// TracedLock (StackTrace.h) records lock, push/pop and wait events for a Chrome trace.
+	// Allocator supplies the storage chunks, PoolAllocator keeps steady state push/pop cycles off malloc.
+	// Container is the backing storage, any sequence container with the std::stack surface works
+	// (std::vector, std::deque, boost::container::small_vector), see ContainerTraits.h.
+	// PersistentStorage shares its nodes with copies, which makes copies and snapshots O(1).
+	template<typename T, typename LockPolicy = DefaultLockPolicy, typename Allocator = std::allocator<T>,
+		typename Container = SegmentedStorage<T, GetDefaultChunkCapacity<T>(), Allocator>>
 	class RWLockStack
 	{
+		static_assert(std::is_same<typename Container::value_type, T>::value, "Container must store T.");
+
 	public:
 		RWLockStack() noexcept;
-		explicit RWLockStack(RWLockStack<T>& stack) noexcept;
-		explicit RWLockStack(RWLockStack<T>&& stack) noexcept;
+		explicit RWLockStack(const StackCapacity& capacity);
+		explicit RWLockStack(RWLockStack<T, LockPolicy, Allocator, Container>& stack) noexcept;
+		// Drains stack the way its pops do: its blocked WaitAndPush callers wake, its watermark
+		// callbacks and statistics see the items leave. The capacity is copied, not taken.
+		explicit RWLockStack(RWLockStack<T, LockPolicy, Allocator, Container>&& stack);
 		explicit RWLockStack(const std::stack<T>& stack) noexcept;
 		explicit RWLockStack(std::stack<T>&& stack) noexcept;
 
-		RWLockStack<T>& Push(const T& item);
-		RWLockStack<T>& Push(const T&& item);
-		RWLockStack<T>& PushRange(RWLockStack<T>& stack);
-		RWLockStack<T>& PushRange(RWLockStack<T>&& stack);
-		RWLockStack<T>& PushRange(const std::stack<T>& stack);
-		RWLockStack<T>& PushRange(std::stack<T>&& stack);
+		RWLockStack<T, LockPolicy, Allocator, Container>& Push(const T& item);
+		RWLockStack<T, LockPolicy, Allocator, Container>& Push(T&& item);
+		// Constructs the item in place under the lock, so T is neither copied nor moved.
+		template<typename... Args>
+		RWLockStack<T, LockPolicy, Allocator, Container>& Emplace(Args&&... args);
+		RWLockStack<T, LockPolicy, Allocator, Container>& PushRange(RWLockStack<T, LockPolicy, Allocator, Container>& stack);
+		RWLockStack<T, LockPolicy, Allocator, Container>& PushRange(RWLockStack<T, LockPolicy, Allocator, Container>&& stack);
+		RWLockStack<T, LockPolicy, Allocator, Container>& PushRange(const std::stack<T>& stack);
+		RWLockStack<T, LockPolicy, Allocator, Container>& PushRange(std::stack<T>&& stack);
 
-		std::stack<T> ExportOrignContainer();
+		// Push and PushRange throw on a full bounded stack, these wait for free space or give up.
+		bool TryPush(const T& item);
+		bool TryPush(T&& item);
+		RWLockStack<T, LockPolicy, Allocator, Container>& WaitAndPush(const T& item);
+		RWLockStack<T, LockPolicy, Allocator, Container>& WaitAndPush(T&& item);
+		template<typename Rep, typename Period>
+		bool WaitAndPushFor(const T& item, const std::chrono::duration<Rep, Period>& timeout);
+		template<typename Rep, typename Period>
+		bool WaitAndPushFor(T&& item, const std::chrono::duration<Rep, Period>& timeout);
+		template<typename Clock, typename Duration>
+		bool WaitAndPushUntil(const T& item, const std::chrono::time_point<Clock, Duration>& deadline);
+		template<typename Clock, typename Duration>
+		bool WaitAndPushUntil(T&& item, const std::chrono::time_point<Clock, Duration>& deadline);
+
+		std::stack<T> ExportOrignContainer() const;
+		// Readers, run under the shared lock when LockPolicy has one, so they proceed in parallel.
+		// Callbacks get const references and must not call back into the stack.
+		std::optional<T> Peek() const;
+		// Returns false without calling function on an empty stack.
+		template<typename Function>
+		bool VisitTop(Function&& function) const;
+		// Visit items from the top down.
+		template<typename Function>
+		void ForEach(Function&& function) const;
+		template<typename Function>
+		void ForEachTopN(const size_t maxCount, Function&& function) const;
+		// Consistent view of the stack as of the call, top item first. O(1) with PersistentStorage,
+		// other containers are copied under the read lock.
+		StackSnapshot<T> Snapshot() const;
 		//TODO Operator = 
 		T TryPop();
+		// Does not throw on empty stack, returns false and leaves item untouched instead.
+		bool TryPop(T& item);
 		T WhaitAndPop();
+		// Blocking pops which give up after the timeout, return false and leave item untouched then.
+		template<typename Rep, typename Period>
+		bool WaitAndPopFor(T& item, const std::chrono::duration<Rep, Period>& timeout);
+		template<typename Clock, typename Duration>
+		bool WaitAndPopUntil(T& item, const std::chrono::time_point<Clock, Duration>& deadline);
+		// Blocks on itemsCount with std::atomic::wait (a futex on Linux) instead of condVar,
+		// a woken consumer does not go through the condition variable's internal mutex.
+		T AtomicWaitAndPop();
+		// Pops up to maxCount items in LIFO order under one lock acquisition, returns popped count.
+		template<typename OutputIt>
+		size_t PopN(size_t maxCount, OutputIt out);
+		std::vector<T> PopN(size_t maxCount);
+		// co_await stack.PopAsync() suspends the coroutine while the stack is empty instead of
+		// blocking its thread. A push hands its item to the longest suspended PopAsync, ahead of
+		// blocked WhaitAndPop callers, and resumes the coroutine after unlocking: inline on the
+		// pushing thread, or by calling executor(coroutineHandle), which may queue it elsewhere.
+		// The waiter is a node of an intrusive list inside the awaiter, so suspension does not
+		// allocate. There is no cancellation, the stack must outlive its suspended coroutines.
+		// Requires a nothrow move constructible T, pushes hand items over in noexcept code.
+		template<typename Executor>
+		class PopAwaiter;
+		PopAwaiter<ResumeInline> PopAsync();
+		template<typename Executor> requires std::invocable<Executor&, std::coroutine_handle<>>
+		PopAwaiter<Executor> PopAsync(Executor executor);
+
+		// Lock free, read a counter which the write paths keep up to date under the lock.
+		bool Empty() const noexcept;
+		uint32_t Size() const noexcept;
+		uint32_t Capacity() const noexcept;
 
-		bool Empty() noexcept;
-		uint32_t Size() noexcept;
+		// Memory controls of the backing container. Capacity() above is the bound of a bounded
+		// stack, StorageCapacity() is how many items fit without the container allocating.
+		void Reserve(const size_t itemsCount);
+		void ShrinkToFit();
+		size_t StorageCapacity() const;
+		size_t MemoryUsage() const;
+
+		// Counters recorded by an InstrumentedLock policy, all zero with any other LockPolicy.
+		StackStatsSnapshot Stats() const noexcept;
+
+	private:
+		using Storage = Container;
+		using Traits = ContainerTraits<Container>;
+		using WatermarkCallback = const std::function<void()>*;
+
+		struct AsyncPopWaiter
+		{
+			AsyncPopWaiter* next;
+			std::optional<T> item;
+			std::coroutine_handle<> coroutine;
+			// hands the coroutine to the executor of the awaiter
+			void (*resume)(AsyncPopWaiter& waiter);
+		};
+
+		// Work left by a write path for after the lock is released.
+		struct AfterUnlock
+		{
+			WatermarkCallback watermarkCallback = nullptr;
+			// PopAsync waiters which got their items, linked in FIFO order
+			AsyncPopWaiter* resumedWaiters = nullptr;
+		};
+
+		RWLockStack<T, LockPolicy, Allocator, Container>& PushStorage(Storage&& storage);
+		template<typename Item, typename WaitFunction>
+		bool PushWhenNotFull(Item&& item, WaitFunction&& waitNotFull);
+		template<typename WaitFunction>
+		bool WaitForItems(std::unique_lock<LockPolicy>& lock, WaitFunction&& waitNotEmpty);
+		// Every wake of a condVar waiter uses up one notification, whichever waiter it was sent to.
+		void OnPopWaiterWoken() noexcept;
+
+		bool IsFull(const size_t itemsToPush = 1) const noexcept;
+		void ThrowIfFull(const size_t itemsToPush = 1) const;
+		// Called under the lock after data changed, return what to run after unlock.
+		AfterUnlock OnItemsPushed(const size_t pushedCount) noexcept;
+		AfterUnlock OnItemsPoped(const size_t popedCount) noexcept;
+		WatermarkCallback CheckWatermarks() noexcept;
+		// Resumes waiters first, a throwing watermark callback can not strand them.
+		static void RunAfterUnlock(const AfterUnlock& afterUnlock);
+		// Pops into waiter, or queues it and returns true when the stack is empty.
+		bool SuspendAsyncPop(AsyncPopWaiter& waiter);
+		// Moves up to leftCount items from the top of data to queued PopAsync waiters, takes the
+		// moved ones off leftCount and returns the served waiters.
+		AsyncPopWaiter* HandOverToAsyncWaiters(size_t& leftCount) noexcept;
+		// Wakes one waiter per item, each woken waiter takes exactly one item and waking more
+		// of them only makes them fight for the lock.
+		// Returns how many waiters were woken.
+		template<typename Waitable>
+		static uint32_t NotifyWaiters(Waitable& waitable, const size_t itemsCount, const uint32_t waitersCount) noexcept;
+		// Contended Push/TryPop: the time from the failed try_lock to the elimination hand-off or
+		// to getting the lock is lock wait. The clock is read only when LockPolicy has statistics,
+		// the elimination attempt is traced as a span.
+		std::chrono::steady_clock::time_point StartContention() const noexcept;
+		void LockContended(std::unique_lock<LockPolicy>& lock, const std::chrono::steady_clock::time_point contendedAt);
+		void OnEliminated(const TraceEventType type, const std::chrono::steady_clock::time_point contendedAt) noexcept;
+		// Compile to nothing unless LockPolicy is an InstrumentedLock or a TracedLock.
+		void RecordStatistics(const StatisticsCounter counter, const uint64_t value = 1) noexcept;
+		void RecordTrace(const TraceEventType type, const size_t value = 0) const noexcept;
+
+		// Every group starts a cache line: threads spinning on the lock, Size() pollers and waiters
+		// do not keep pulling away the line with the top of the stack. The class is aligned to a
+		// cache line as a result, so stacks next to each other in an array never share one.
+		alignas(CACHE_LINE_SIZE) mutable LockPolicy mutex;
+
+		// written under the lock only
+		alignas(CACHE_LINE_SIZE) Storage data;
+		StackCapacity stackCapacity;
+		bool isAboveHighWatermark;
+		// blocked WhaitAndPop/WaitAndPush callers, so we wake only as many of them as can proceed
+		uint32_t waitingPopsCount;
+		// waitingPopsCount callers notified but not woken yet, pushes skip them and wake others
+		uint32_t notifiedPopsCount;
+		uint32_t waitingPushesCount;
+		uint32_t atomicWaitingPopsCount;
+		// suspended PopAsync callers, served first in first out
+		AsyncPopWaiter* asyncWaitersHead;
+		AsyncPopWaiter* asyncWaitersTail;
+
+		// mirrors data.size(), written only under the exclusive lock so a plain store is enough
+		alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> itemsCount;
+
+		alignas(CACHE_LINE_SIZE) std::condition_variable_any condVar;
+		std::condition_variable_any notFullCondVar;
+		EliminationArray<T> elimination;
+	};
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Executor>
+	class RWLockStack<T, LockPolicy, Allocator, Container>::PopAwaiter : private AsyncPopWaiter
+	{
+	public:
+		PopAwaiter(RWLockStack<T, LockPolicy, Allocator, Container>& stack, Executor&& executor);
+		PopAwaiter(const PopAwaiter&) = delete;
+		PopAwaiter& operator=(const PopAwaiter&) = delete;
+
+		bool await_ready() const noexcept;
+		bool await_suspend(std::coroutine_handle<> coroutine);
+		T await_resume();
 
 	private:
-		std::stack<T> data;
-		boost::shared_mutex mutex;
-		std::condition_variable_any condVar;
+		static void Resume(AsyncPopWaiter& waiter);
+
+		RWLockStack<T, LockPolicy, Allocator, Container>& stack;
+		Executor executor;
 	};
 
-	template<typename T>
-	RWLockStack<T>::RWLockStack() noexcept
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>::RWLockStack() noexcept
+		: isAboveHighWatermark(false),
+		waitingPopsCount(0),
+		notifiedPopsCount(0),
+		waitingPushesCount(0),
+		atomicWaitingPopsCount(0),
+		asyncWaitersHead(nullptr),
+		asyncWaitersTail(nullptr),
+		itemsCount(0)
 	{
 	}
 
-	template<typename T>
-	RWLockStack<T>::RWLockStack(RWLockStack<T>& stack) noexcept
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>::RWLockStack(const StackCapacity& capacity)
+		: stackCapacity(capacity),
+		isAboveHighWatermark(false),
+		waitingPopsCount(0),
+		notifiedPopsCount(0),
+		waitingPushesCount(0),
+		atomicWaitingPopsCount(0),
+		asyncWaitersHead(nullptr),
+		asyncWaitersTail(nullptr),
+		itemsCount(0)
 	{
-		const std::shared_lock<boost::shared_mutex> lock(stack.mutex);
-		data = stack.data;
+		if (capacity.capacity == 0 || capacity.lowWatermark > capacity.highWatermark)
+		{
+			throw ThreadSafeStructs::ThreadSafetyException("Stack capacity is zero or low watermark is above high watermark.");
+		}
+		if (capacity.capacity != UNBOUNDED_CAPACITY)
+		{
+			// steady state push/pop cycles reuse these chunks and never allocate
+			Traits::Reserve(data, capacity.capacity);
+		}
 	}
 
-	template<typename T>
-	RWLockStack<T>::RWLockStack(RWLockStack<T>&& stack) noexcept
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>::RWLockStack(RWLockStack<T, LockPolicy, Allocator, Container>& stack) noexcept
+		: isAboveHighWatermark(false),
+		waitingPopsCount(0),
+		notifiedPopsCount(0),
+		waitingPushesCount(0),
+		atomicWaitingPopsCount(0),
+		asyncWaitersHead(nullptr),
+		asyncWaitersTail(nullptr),
+		itemsCount(0)
 	{
-		const std::lock_guard<boost::shared_mutex> lock(stack.mutex);
-		data = std::move(stack.data);
+		{
+			const ReadLock<LockPolicy> lock(stack.mutex);
+			data = stack.data;
+			stackCapacity = stack.stackCapacity;
+			isAboveHighWatermark = stack.isAboveHighWatermark;
+		}
+		itemsCount.store(static_cast<uint32_t>(data.size()), std::memory_order_release);
+		if (stackCapacity.capacity != UNBOUNDED_CAPACITY)
+		{
+			// copying the storage copies the items only, not the reserve of the source
+			Traits::Reserve(data, stackCapacity.capacity);
+		}
 	}
 
-	template<typename T>
-	RWLockStack<T>::RWLockStack(const std::stack<T>& stack) noexcept
-		: data(stack)
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>::RWLockStack(RWLockStack<T, LockPolicy, Allocator, Container>&& stack)
+		: isAboveHighWatermark(false),
+		waitingPopsCount(0),
+		notifiedPopsCount(0),
+		waitingPushesCount(0),
+		atomicWaitingPopsCount(0),
+		asyncWaitersHead(nullptr),
+		asyncWaitersTail(nullptr),
+		itemsCount(0)
 	{
+		AfterUnlock sourceAfterUnlock;
+		{
+			const std::lock_guard<LockPolicy> lock(stack.mutex);
+			const auto movedCount = stack.data.size();
+			data = std::move(stack.data);
+			stackCapacity = stack.stackCapacity;
+			isAboveHighWatermark = stack.isAboveHighWatermark;
+			itemsCount.store(static_cast<uint32_t>(data.size()), std::memory_order_release);
+			sourceAfterUnlock = stack.OnItemsPoped(movedCount);
+		}
+		RunAfterUnlock(sourceAfterUnlock);
 	}
 
-	template<typename T>
-	RWLockStack<T>::RWLockStack(std::stack<T>&& stack) noexcept
-		: data(std::forward<std::stack<T>>(stack))
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>::RWLockStack(const std::stack<T>& stack) noexcept
+		: data(ConvertStackToStorage<Storage>(stack)),
+		isAboveHighWatermark(false),
+		waitingPopsCount(0),
+		notifiedPopsCount(0),
+		waitingPushesCount(0),
+		atomicWaitingPopsCount(0),
+		asyncWaitersHead(nullptr),
+		asyncWaitersTail(nullptr),
+		itemsCount(static_cast<uint32_t>(data.size()))
 	{
 	}
 
-	template<typename T>
-	bool RWLockStack<T>::Empty() noexcept 
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>::RWLockStack(std::stack<T>&& stack) noexcept
+		: data(ConvertStackToStorage<Storage>(std::move(stack))),
+		isAboveHighWatermark(false),
+		waitingPopsCount(0),
+		notifiedPopsCount(0),
+		waitingPushesCount(0),
+		atomicWaitingPopsCount(0),
+		asyncWaitersHead(nullptr),
+		asyncWaitersTail(nullptr),
+		itemsCount(static_cast<uint32_t>(data.size()))
 	{
-		const std::shared_lock<boost::shared_mutex> lock(mutex);
-		return data.empty();
 	}
 
-	template<typename T>
-	uint32_t RWLockStack<T>::Size() noexcept
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::Empty() const noexcept
 	{
-		const std::shared_lock<boost::shared_mutex> lock(mutex);
-		return static_cast<uint32_t>(data.size());
+		return itemsCount.load(std::memory_order_acquire) == 0;
 	}
 
-	template<typename T>
-	RWLockStack<T>& RWLockStack<T>::Push(const T& item)
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	uint32_t RWLockStack<T, LockPolicy, Allocator, Container>::Size() const noexcept
 	{
-		const std::lock_guard<boost::shared_mutex> lock(mutex);
-		data.push(item);
-		condVar.notify_all();
-		return *this;
+		return itemsCount.load(std::memory_order_acquire);
 	}
 
-	template<typename T>
-	RWLockStack<T>& RWLockStack<T>::Push(const T&& item)
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	uint32_t RWLockStack<T, LockPolicy, Allocator, Container>::Capacity() const noexcept
 	{
-		const std::lock_guard<boost::shared_mutex> lock(mutex);
-		data.push(std::move(item));
-		condVar.notify_all();
+		return stackCapacity.capacity;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::Reserve(const size_t itemsCount)
+	{
+		const std::lock_guard<LockPolicy> lock(mutex);
+		Traits::Reserve(data, itemsCount);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::ShrinkToFit()
+	{
+		const std::lock_guard<LockPolicy> lock(mutex);
+		Traits::ShrinkToFit(data);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	size_t RWLockStack<T, LockPolicy, Allocator, Container>::StorageCapacity() const
+	{
+		const ReadLock<LockPolicy> lock(mutex);
+		return Traits::Capacity(data);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	size_t RWLockStack<T, LockPolicy, Allocator, Container>::MemoryUsage() const
+	{
+		const ReadLock<LockPolicy> lock(mutex);
+		return sizeof(*this) - sizeof(data) + Traits::MemoryUsage(data);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	StackStatsSnapshot RWLockStack<T, LockPolicy, Allocator, Container>::Stats() const noexcept
+	{
+		if constexpr (HasLockStatistics<LockPolicy>::value)
+		{
+			return mutex.Statistics().Snapshot();
+		}
+		else
+		{
+			return StackStatsSnapshot();
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::Push(const T& item)
+	{
+		std::unique_lock<LockPolicy> lock(mutex, std::try_to_lock);
+		if (lock.owns_lock())
+		{
+			ThrowIfFull();
+			data.push_back(item);
+		}
+		else
+		{
+			// contended, try to hand the item to a concurrent TryPop before queueing on the lock
+			const auto contendedAt = StartContention();
+			T handOffItem(item);
+			if (elimination.TryHandOff(handOffItem))
+			{
+				OnEliminated(PUSH_EVENT, contendedAt);
+				return *this;
+			}
+			LockContended(lock, contendedAt);
+			ThrowIfFull();
+			data.push_back(std::move(handOffItem));
+		}
+		auto afterUnlock = OnItemsPushed(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
 		return *this;
 	}
 
-	template<typename T>
-	RWLockStack<T>& RWLockStack<T>::PushRange(RWLockStack<T>& rwLockStack)
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::Push(T&& item)
 	{
-		std::unique_lock<boost::shared_mutex> dataToCopy(rwLockStack.mutex, std::defer_lock);
-		std::unique_lock<boost::shared_mutex> orignData(mutex, std::defer_lock);
-		std::lock(dataToCopy, orignData);
+		std::unique_lock<LockPolicy> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			// item is moved out only if a popper takes it
+			const auto contendedAt = StartContention();
+			if (elimination.TryHandOff(item))
+			{
+				OnEliminated(PUSH_EVENT, contendedAt);
+				return *this;
+			}
+			LockContended(lock, contendedAt);
+		}
+		ThrowIfFull();
+		data.push_back(std::move(item));
 
-		// we emulate data.push_range(stack); from unsupported C++23
-		AppendStackToStack(data, rwLockStack.data);
+		auto afterUnlock = OnItemsPushed(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
+		return *this;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename... Args>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::Emplace(Args&&... args)
+	{
+		std::unique_lock<LockPolicy> lock(mutex);
+		ThrowIfFull();
+		data.emplace_back(std::forward<Args>(args)...);
 
-		condVar.notify_all();
+		auto afterUnlock = OnItemsPushed(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
 		return *this;
 	}
 
-	template<typename T>
-	RWLockStack<T>& RWLockStack<T>::PushRange(RWLockStack<T>&& rwLockStack)
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::PushRange(RWLockStack<T, LockPolicy, Allocator, Container>& rwLockStack)
 	{
-		std::unique_lock<boost::shared_mutex> dataToCopy(rwLockStack.mutex, std::defer_lock);
-		std::unique_lock<boost::shared_mutex> orignData(mutex, std::defer_lock);
-		std::lock(dataToCopy, orignData);
+		Storage dataToAppend;
+		{
+			const ReadLock<LockPolicy> lock(rwLockStack.mutex);
+			dataToAppend = rwLockStack.data;
+		}
+		return PushStorage(std::move(dataToAppend));
+	}
 
-		// we emulate data.push_range(stack); from unsupported C++23
-		AppendStackToStack(data, std::forward<std::stack<T>>(rwLockStack.data));
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::PushRange(RWLockStack<T, LockPolicy, Allocator, Container>&& rwLockStack)
+	{
+		if (&rwLockStack == this)
+		{
+			return *this;
+		}
+		// both locks, taken in address order, so a full stack rejects the range before the source is drained
+		std::unique_lock<LockPolicy> lock(mutex, std::defer_lock);
+		std::unique_lock<LockPolicy> sourceLock(rwLockStack.mutex, std::defer_lock);
+		if (this < &rwLockStack)
+		{
+			lock.lock();
+			sourceLock.lock();
+		}
+		else
+		{
+			sourceLock.lock();
+			lock.lock();
+		}
+		const auto pushedCount = rwLockStack.data.size();
+		ThrowIfFull(pushedCount);
+		Traits::Splice(data, std::move(rwLockStack.data));
 
-		condVar.notify_all();
+		auto sourceAfterUnlock = rwLockStack.OnItemsPoped(pushedCount);
+		auto afterUnlock = OnItemsPushed(pushedCount);
+		sourceLock.unlock();
+		lock.unlock();
+		RunAfterUnlock(sourceAfterUnlock);
+		RunAfterUnlock(afterUnlock);
 		return *this;
 	}
 
-	template<typename T>
-	RWLockStack<T>& RWLockStack<T>::PushRange(const std::stack<T>& stack)
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::PushRange(const std::stack<T>& stack)
 	{
-		std::lock_guard<boost::shared_mutex> lock(mutex);
+		return PushStorage(ConvertStackToStorage<Storage>(stack));
+	}
 
-		// we emulate data.push_range(stack); from unsupported C++23
-		AppendStackToStack(data, stack);
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::PushRange(std::stack<T>&& stack)
+	{
+		auto storage = ConvertStackToStorage<Storage>(std::move(stack));
+		try
+		{
+			return PushStorage(std::move(storage));
+		}
+		catch (const ThreadSafeStructs::ThreadSafetyException&)
+		{
+			// a full stack rejected the range, its items go back where they came from
+			MoveStorageBackToStack(std::move(storage), stack);
+			throw;
+		}
+	}
 
-		condVar.notify_all();
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::PushStorage(Storage&& storage)
+	{
+		// items are already laid out in chunks, under the lock we only relink them
+		std::unique_lock<LockPolicy> lock(mutex);
+		const auto pushedCount = storage.size();
+		ThrowIfFull(pushedCount);
+		Traits::Splice(data, std::move(storage));
+
+		auto afterUnlock = OnItemsPushed(pushedCount);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
 		return *this;
 	}
 
-	template<typename T>
-	RWLockStack<T>& RWLockStack<T>::PushRange(std::stack<T>&& stack)
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::TryPush(const T& item)
+	{
+		return PushWhenNotFull(item, [](std::unique_lock<LockPolicy>&) { return false; });
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::TryPush(T&& item)
 	{
-		std::lock_guard<boost::shared_mutex> lock(mutex);
+		return PushWhenNotFull(std::move(item), [](std::unique_lock<LockPolicy>&) { return false; });
+	}
 
-		// we emulate data.push_range(stack); from unsupported C++23
-		AppendStackToStack(data, std::forward<std::stack<T>>(stack));
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPush(const T& item)
+	{
+		PushWhenNotFull(item, [this](std::unique_lock<LockPolicy>& lock)
+			{
+				notFullCondVar.wait(lock, [this]() { return !IsFull(); });
+				return true;
+			});
+		return *this;
+	}
 
-		condVar.notify_all();
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	RWLockStack<T, LockPolicy, Allocator, Container>& RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPush(T&& item)
+	{
+		PushWhenNotFull(std::move(item), [this](std::unique_lock<LockPolicy>& lock)
+			{
+				notFullCondVar.wait(lock, [this]() { return !IsFull(); });
+				return true;
+			});
 		return *this;
 	}
 
-	template<typename T>
-	T RWLockStack<T>::TryPop()
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Rep, typename Period>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPushFor(const T& item, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return WaitAndPushUntil(item, std::chrono::steady_clock::now() + timeout);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Rep, typename Period>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPushFor(T&& item, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return WaitAndPushUntil(std::move(item), std::chrono::steady_clock::now() + timeout);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Clock, typename Duration>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPushUntil(const T& item, const std::chrono::time_point<Clock, Duration>& deadline)
+	{
+		return PushWhenNotFull(item, [this, &deadline](std::unique_lock<LockPolicy>& lock)
+			{
+				return notFullCondVar.wait_until(lock, deadline, [this]() { return !IsFull(); });
+			});
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Clock, typename Duration>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPushUntil(T&& item, const std::chrono::time_point<Clock, Duration>& deadline)
 	{
-		const std::lock_guard<boost::shared_mutex> lock(mutex);
+		return PushWhenNotFull(std::move(item), [this, &deadline](std::unique_lock<LockPolicy>& lock)
+			{
+				return notFullCondVar.wait_until(lock, deadline, [this]() { return !IsFull(); });
+			});
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Item, typename WaitFunction>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::PushWhenNotFull(Item&& item, WaitFunction&& waitNotFull)
+	{
+		std::unique_lock<LockPolicy> lock(mutex);
+		if (IsFull())
+		{
+			++waitingPushesCount;
+			const auto hasSpace = waitNotFull(lock);
+			--waitingPushesCount;
+			if (!hasSpace)
+			{
+				return false;
+			}
+		}
+		data.push_back(std::forward<Item>(item));
+
+		auto afterUnlock = OnItemsPushed(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
+		return true;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	T RWLockStack<T, LockPolicy, Allocator, Container>::TryPop()
+	{
+		std::unique_lock<LockPolicy> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			const auto contendedAt = StartContention();
+			if (auto offer = elimination.TryClaim())
+			{
+				auto item = EliminationArray<T>::Take(offer);
+				OnEliminated(POP_EVENT, contendedAt);
+				return item;
+			}
+			LockContended(lock, contendedAt);
+		}
 		if (data.empty())
 		{
 			throw ThreadSafeStructs::ThreadSafetyException("Item can not be poped from stack, stack is empty.");
 		}
-		auto dataItem = data.top();
-		data.pop();
+		auto dataItem = std::move(data.back());
+		data.pop_back();
+
+		auto afterUnlock = OnItemsPoped(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
 		return dataItem;
 	}
 
-	template<typename T>
-	T RWLockStack<T>::WhaitAndPop()
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::TryPop(T& item)
 	{
-		auto tmp = data.empty(); //TODO POP if not empty
+		std::unique_lock<LockPolicy> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			const auto contendedAt = StartContention();
+			if (auto offer = elimination.TryClaim())
+			{
+				item = EliminationArray<T>::Take(offer);
+				OnEliminated(POP_EVENT, contendedAt);
+				return true;
+			}
+			LockContended(lock, contendedAt);
+		}
+		if (data.empty())
+		{
+			return false;
+		}
+		item = std::move(data.back());
+		data.pop_back();
 
-		std::unique_lock<boost::shared_mutex> uniqueLock(mutex);
-		this->condVar.wait(uniqueLock); //TODO add predicate
-		const std::lock_guard<boost::shared_mutex> lock(mutex);
+		auto afterUnlock = OnItemsPoped(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
+		return true;
+	}
 
-		auto dataItem = data.top();
-		data.pop();
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename OutputIt>
+	size_t RWLockStack<T, LockPolicy, Allocator, Container>::PopN(size_t maxCount, OutputIt out)
+	{
+		std::unique_lock<LockPolicy> lock(mutex);
+		size_t popedCount = 0;
+		try
+		{
+			for (; popedCount < maxCount && !data.empty(); ++popedCount)
+			{
+				*out = std::move(data.back());
+				++out;
+				data.pop_back();
+			}
+		}
+		catch (...)
+		{
+			// the items popped before out threw are gone from data, count them anyway
+			auto afterUnlock = OnItemsPoped(popedCount);
+			lock.unlock();
+			RunAfterUnlock(afterUnlock);
+			throw;
+		}
+
+		auto afterUnlock = OnItemsPoped(popedCount);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
+		return popedCount;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	std::vector<T> RWLockStack<T, LockPolicy, Allocator, Container>::PopN(size_t maxCount)
+	{
+		// reserved before taking the lock, so the allocation usually stays out of the critical
+		// section; items pushed after Size() was read can still make it grow under the lock
+		std::vector<T> items;
+		items.reserve(std::min<size_t>(maxCount, Size()));
+		PopN(maxCount, std::back_inserter(items));
+		return items;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	T RWLockStack<T, LockPolicy, Allocator, Container>::WhaitAndPop()
+	{
+		std::unique_lock<LockPolicy> lock(mutex);
+		WaitForItems(lock, [this](std::unique_lock<LockPolicy>& lock)
+			{
+				while (data.empty())
+				{
+					condVar.wait(lock);
+					OnPopWaiterWoken();
+				}
+				return true;
+			});
+
+		auto dataItem = std::move(data.back());
+		data.pop_back();
+
+		auto afterUnlock = OnItemsPoped(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
 		return dataItem;
 	}
 
-	template<typename T>
-	std::stack<T> RWLockStack<T>::ExportOrignContainer()
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Rep, typename Period>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPopFor(T& item, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		return WaitAndPopUntil(item, std::chrono::steady_clock::now() + timeout);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Clock, typename Duration>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::WaitAndPopUntil(T& item, const std::chrono::time_point<Clock, Duration>& deadline)
 	{
-		return data;
+		std::unique_lock<LockPolicy> lock(mutex);
+		const auto hasItems = WaitForItems(lock, [this, &deadline](std::unique_lock<LockPolicy>& lock)
+			{
+				while (data.empty())
+				{
+					const auto status = condVar.wait_until(lock, deadline);
+					OnPopWaiterWoken();
+					if (status == std::cv_status::timeout)
+					{
+						return !data.empty();
+					}
+				}
+				return true;
+			});
+		if (!hasItems)
+		{
+			return false;
+		}
+
+		item = std::move(data.back());
+		data.pop_back();
+
+		auto afterUnlock = OnItemsPoped(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
+		return true;
 	}
-}
\ No newline at end of file
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	T RWLockStack<T, LockPolicy, Allocator, Container>::AtomicWaitAndPop()
+	{
+		std::unique_lock<LockPolicy> lock(mutex);
+		if (data.empty())
+		{
+			RecordStatistics(WAIT_BLOCKS);
+		}
+		while (data.empty())
+		{
+			// registered under the lock, so a pusher which sees no waiters has stored itemsCount before we wait on it
+			++atomicWaitingPopsCount;
+			lock.unlock();
+			RecordTrace(WAIT_EVENT);
+			itemsCount.wait(0, std::memory_order_acquire);
+			RecordTrace(WAKE_EVENT);
+			RecordStatistics(WAKE_UPS);
+			lock.lock();
+			--atomicWaitingPopsCount;
+		}
+
+		auto dataItem = std::move(data.back());
+		data.pop_back();
+
+		auto afterUnlock = OnItemsPoped(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
+		return dataItem;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	typename RWLockStack<T, LockPolicy, Allocator, Container>::template PopAwaiter<ResumeInline> RWLockStack<T, LockPolicy, Allocator, Container>::PopAsync()
+	{
+		return PopAwaiter<ResumeInline>(*this, ResumeInline());
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Executor> requires std::invocable<Executor&, std::coroutine_handle<>>
+	typename RWLockStack<T, LockPolicy, Allocator, Container>::template PopAwaiter<Executor> RWLockStack<T, LockPolicy, Allocator, Container>::PopAsync(Executor executor)
+	{
+		return PopAwaiter<Executor>(*this, std::move(executor));
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Executor>
+	RWLockStack<T, LockPolicy, Allocator, Container>::PopAwaiter<Executor>::PopAwaiter(RWLockStack<T, LockPolicy, Allocator, Container>& stack, Executor&& executor)
+		: AsyncPopWaiter{ nullptr, std::nullopt, nullptr, &PopAwaiter::Resume },
+		stack(stack),
+		executor(std::move(executor))
+	{
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Executor>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::PopAwaiter<Executor>::await_ready() const noexcept
+	{
+		// the empty check and queueing have to happen under one lock, await_suspend does both
+		return false;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Executor>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::PopAwaiter<Executor>::await_suspend(std::coroutine_handle<> coroutine)
+	{
+		this->coroutine = coroutine;
+		return stack.SuspendAsyncPop(*this);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Executor>
+	T RWLockStack<T, LockPolicy, Allocator, Container>::PopAwaiter<Executor>::await_resume()
+	{
+		return std::move(*this->item);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Executor>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::PopAwaiter<Executor>::Resume(AsyncPopWaiter& waiter)
+	{
+		auto& awaiter = static_cast<PopAwaiter&>(waiter);
+		// the awaiter ends with the coroutine, which may run on another thread before executor returns
+		auto executor = std::move(awaiter.executor);
+		executor(awaiter.coroutine);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::SuspendAsyncPop(AsyncPopWaiter& waiter)
+	{
+		// waiters are queued only here, so HandOverToAsyncWaiters moves items only for such T
+		static_assert(std::is_nothrow_move_constructible_v<T>,
+			"PopAsync requires a nothrow move constructible T, a push moves items to waiters under noexcept");
+		std::unique_lock<LockPolicy> lock(mutex);
+		if (data.empty())
+		{
+			waiter.next = nullptr;
+			if (asyncWaitersTail != nullptr)
+			{
+				asyncWaitersTail->next = &waiter;
+			}
+			else
+			{
+				asyncWaitersHead = &waiter;
+			}
+			asyncWaitersTail = &waiter;
+			RecordStatistics(WAIT_BLOCKS);
+			RecordTrace(WAIT_EVENT);
+			// a pusher may resume the coroutine as soon as the lock is released, waiter is not touched after that
+			return true;
+		}
+		waiter.item.emplace(std::move(data.back()));
+		data.pop_back();
+
+		auto afterUnlock = OnItemsPoped(1);
+		lock.unlock();
+		RunAfterUnlock(afterUnlock);
+		return false;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename WaitFunction>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::WaitForItems(std::unique_lock<LockPolicy>& lock, WaitFunction&& waitNotEmpty)
+	{
+		if (!data.empty())
+		{
+			return true;
+		}
+		++waitingPopsCount;
+		RecordStatistics(WAIT_BLOCKS);
+		RecordTrace(WAIT_EVENT);
+		const auto hasItems = waitNotEmpty(lock);
+		RecordTrace(WAKE_EVENT);
+		RecordStatistics(WAKE_UPS);
+		--waitingPopsCount;
+		return hasItems;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::OnPopWaiterWoken() noexcept
+	{
+		if (notifiedPopsCount > 0)
+		{
+			--notifiedPopsCount;
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	std::stack<T> RWLockStack<T, LockPolicy, Allocator, Container>::ExportOrignContainer() const
+	{
+		std::stack<T> exported;
+		const ReadLock<LockPolicy> lock(mutex);
+		Traits::ForEachFromBottom(data, [&exported](const T& item) { exported.push(item); });
+		return exported;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	std::optional<T> RWLockStack<T, LockPolicy, Allocator, Container>::Peek() const
+	{
+		const ReadLock<LockPolicy> lock(mutex);
+		if (data.empty())
+		{
+			return std::nullopt;
+		}
+		return data.back();
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Function>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::VisitTop(Function&& function) const
+	{
+		const ReadLock<LockPolicy> lock(mutex);
+		if (data.empty())
+		{
+			return false;
+		}
+		function(data.back());
+		return true;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Function>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::ForEach(Function&& function) const
+	{
+		ForEachTopN(std::numeric_limits<size_t>::max(), std::forward<Function>(function));
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Function>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::ForEachTopN(const size_t maxCount, Function&& function) const
+	{
+		const ReadLock<LockPolicy> lock(mutex);
+		Traits::ForEachFromTop(data, maxCount, [&function](const T& item) { function(item); });
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	StackSnapshot<T> RWLockStack<T, LockPolicy, Allocator, Container>::Snapshot() const
+	{
+		const ReadLock<LockPolicy> lock(mutex);
+		return Traits::Snapshot(data);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	bool RWLockStack<T, LockPolicy, Allocator, Container>::IsFull(const size_t itemsToPush) const noexcept
+	{
+		return data.size() + itemsToPush > stackCapacity.capacity;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::ThrowIfFull(const size_t itemsToPush) const
+	{
+		if (IsFull(itemsToPush))
+		{
+			throw ThreadSafeStructs::ThreadSafetyException("Items can not be pushed to stack, stack is full.");
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	typename RWLockStack<T, LockPolicy, Allocator, Container>::AfterUnlock RWLockStack<T, LockPolicy, Allocator, Container>::OnItemsPushed(const size_t pushedCount) noexcept
+	{
+		RecordTrace(PUSH_EVENT, pushedCount);
+		AfterUnlock afterUnlock;
+		auto leftCount = pushedCount;
+		afterUnlock.resumedWaiters = HandOverToAsyncWaiters(leftCount);
+		itemsCount.store(static_cast<uint32_t>(data.size()), std::memory_order_release);
+
+		const auto notifiedPops = NotifyWaiters(condVar, leftCount, waitingPopsCount - notifiedPopsCount);
+		notifiedPopsCount += notifiedPops;
+		// items already promised to condVar waiters wake no atomic waiter
+		auto notifiedCount = notifiedPops + NotifyWaiters(itemsCount, leftCount - notifiedPops, atomicWaitingPopsCount);
+		// handed over items left their space of a bounded stack free again
+		notifiedCount += NotifyWaiters(notFullCondVar, pushedCount - leftCount, waitingPushesCount);
+		if constexpr (HasLockStatistics<LockPolicy>::value)
+		{
+			mutex.Statistics().UpdatePeakSize(data.size());
+			if (notifiedCount > 0)
+			{
+				mutex.Statistics().Add(NOTIFIES, notifiedCount);
+			}
+		}
+		afterUnlock.watermarkCallback = CheckWatermarks();
+		return afterUnlock;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	typename RWLockStack<T, LockPolicy, Allocator, Container>::AsyncPopWaiter* RWLockStack<T, LockPolicy, Allocator, Container>::HandOverToAsyncWaiters(size_t& leftCount) noexcept
+	{
+		if (asyncWaitersHead == nullptr || leftCount == 0)
+		{
+			return nullptr;
+		}
+		// waiters are queued only on an empty stack, so they get the pushed items only
+		auto resumedWaiters = asyncWaitersHead;
+		AsyncPopWaiter* lastWaiter = nullptr;
+		size_t handedOverCount = 0;
+		for (; asyncWaitersHead != nullptr && handedOverCount < leftCount; ++handedOverCount)
+		{
+			lastWaiter = asyncWaitersHead;
+			lastWaiter->item.emplace(std::move(data.back()));
+			data.pop_back();
+			asyncWaitersHead = lastWaiter->next;
+		}
+		// the served waiters stay linked in queue order, cut them off the rest
+		lastWaiter->next = nullptr;
+		if (asyncWaitersHead == nullptr)
+		{
+			asyncWaitersTail = nullptr;
+		}
+		leftCount -= handedOverCount;
+		RecordTrace(POP_EVENT, handedOverCount);
+		RecordStatistics(WAKE_UPS, handedOverCount);
+		return resumedWaiters;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	typename RWLockStack<T, LockPolicy, Allocator, Container>::AfterUnlock RWLockStack<T, LockPolicy, Allocator, Container>::OnItemsPoped(const size_t popedCount) noexcept
+	{
+		if (popedCount == 0)
+		{
+			return AfterUnlock();
+		}
+		itemsCount.store(static_cast<uint32_t>(data.size()), std::memory_order_release);
+		RecordTrace(POP_EVENT, popedCount);
+		const auto notifiedCount = NotifyWaiters(notFullCondVar, popedCount, waitingPushesCount);
+		if (notifiedCount > 0)
+		{
+			RecordStatistics(NOTIFIES, notifiedCount);
+		}
+		AfterUnlock afterUnlock;
+		afterUnlock.watermarkCallback = CheckWatermarks();
+		return afterUnlock;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	typename RWLockStack<T, LockPolicy, Allocator, Container>::WatermarkCallback RWLockStack<T, LockPolicy, Allocator, Container>::CheckWatermarks() noexcept
+	{
+		if (!isAboveHighWatermark && data.size() >= stackCapacity.highWatermark)
+		{
+			isAboveHighWatermark = true;
+			return stackCapacity.onHighWatermark ? &stackCapacity.onHighWatermark : nullptr;
+		}
+		if (isAboveHighWatermark && data.size() <= stackCapacity.lowWatermark)
+		{
+			isAboveHighWatermark = false;
+			return stackCapacity.onLowWatermark ? &stackCapacity.onLowWatermark : nullptr;
+		}
+		return nullptr;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::RunAfterUnlock(const AfterUnlock& afterUnlock)
+	{
+		for (auto waiter = afterUnlock.resumedWaiters; waiter != nullptr;)
+		{
+			// the waiter lives in the coroutine frame, which may be gone once it is resumed
+			const auto nextWaiter = waiter->next;
+			waiter->resume(*waiter);
+			waiter = nextWaiter;
+		}
+		if (afterUnlock.watermarkCallback)
+		{
+			(*afterUnlock.watermarkCallback)();
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	template<typename Waitable>
+	uint32_t RWLockStack<T, LockPolicy, Allocator, Container>::NotifyWaiters(Waitable& waitable, const size_t itemsCount, const uint32_t waitersCount) noexcept
+	{
+		if (waitersCount == 0)
+		{
+			return 0;
+		}
+		if (itemsCount >= waitersCount)
+		{
+			waitable.notify_all();
+			return waitersCount;
+		}
+		for (size_t notified = 0; notified < itemsCount; ++notified)
+		{
+			waitable.notify_one();
+		}
+		return static_cast<uint32_t>(itemsCount);
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	std::chrono::steady_clock::time_point RWLockStack<T, LockPolicy, Allocator, Container>::StartContention() const noexcept
+	{
+		RecordTrace(ELIMINATION_START_EVENT);
+		if constexpr (HasLockStatistics<LockPolicy>::value)
+		{
+			return std::chrono::steady_clock::now();
+		}
+		else
+		{
+			return std::chrono::steady_clock::time_point();
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::LockContended(std::unique_lock<LockPolicy>& lock, const std::chrono::steady_clock::time_point contendedAt)
+	{
+		RecordTrace(ELIMINATION_END_EVENT, 0);
+		if constexpr (requires { mutex.LockAfterFailedTry(contendedAt); })
+		{
+			// the lock's own try_lock would usually succeed by now and record no contention
+			mutex.LockAfterFailedTry(contendedAt);
+			lock = std::unique_lock<LockPolicy>(mutex, std::adopt_lock);
+		}
+		else
+		{
+			lock.lock();
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::OnEliminated(const TraceEventType type, const std::chrono::steady_clock::time_point contendedAt) noexcept
+	{
+		RecordTrace(ELIMINATION_END_EVENT, 1);
+		// the operation never reaches OnItemsPushed/OnItemsPoped, which trace the others
+		RecordTrace(type, 1);
+		if constexpr (HasLockStatistics<LockPolicy>::value)
+		{
+			mutex.Statistics().Add(ELIMINATED_OPERATIONS);
+			mutex.Statistics().Add(LOCK_WAIT_NANOSECONDS, static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - contendedAt).count()));
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::RecordStatistics(const StatisticsCounter counter, const uint64_t value) noexcept
+	{
+		if constexpr (HasLockStatistics<LockPolicy>::value)
+		{
+			mutex.Statistics().Add(counter, value);
+		}
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator, typename Container>
+	void RWLockStack<T, LockPolicy, Allocator, Container>::RecordTrace(const TraceEventType type, const size_t value) const noexcept
+	{
+		if constexpr (IsTracedLock<LockPolicy>::value)
+		{
+			// events of the stack share the address of its lock, so they line up with the lock spans
+			Tracer::Record(type, &mutex, static_cast<uint32_t>(value));
+		}
+	}
+}
@@ -0,0 +1,452 @@
+#pragma once
+
+namespace ThreadSafeStructs
+{
+	const uint32_t DEFAULT_CHUNK_BYTES = 4096;
+	const uint32_t MIN_CHUNK_CAPACITY = 16;
+
+	template<typename T>
+	constexpr uint32_t GetDefaultChunkCapacity() noexcept
+	{
+		return sizeof(T) * MIN_CHUNK_CAPACITY >= DEFAULT_CHUNK_BYTES
+			? MIN_CHUNK_CAPACITY
+			: static_cast<uint32_t>(DEFAULT_CHUNK_BYTES / sizeof(T));
+	}
+
+	// Stack storage made of linked fixed-size chunks. Items never move once pushed and a whole
+	// storage can be put on top of another one by relinking chunks (Splice), without touching items.
+	// Exposes the back()/push_back()/pop_back() surface so it can stand in for std::stack's container.
+	// Chunks come from Allocator rebound to the chunk type; storages which splice into each other
+	// must use allocators that compare equal.
+	template<typename T, uint32_t ChunkCapacity = GetDefaultChunkCapacity<T>(), typename Allocator = std::allocator<T>>
+	class SegmentedStorage
+	{
+	public:
+		using value_type = T;
+		using size_type = size_t;
+		using reference = T&;
+		using const_reference = const T&;
+		using allocator_type = Allocator;
+
+		SegmentedStorage() noexcept;
+		explicit SegmentedStorage(const Allocator& allocator) noexcept;
+		SegmentedStorage(const SegmentedStorage& storage);
+		SegmentedStorage(SegmentedStorage&& storage) noexcept;
+		~SegmentedStorage();
+
+		SegmentedStorage& operator=(const SegmentedStorage& storage);
+		SegmentedStorage& operator=(SegmentedStorage&& storage) noexcept;
+
+		void push_back(const T& item);
+		void push_back(T&& item);
+		template<typename... Args>
+		void emplace_back(Args&&... args);
+		void pop_back();
+
+		T& back();
+		const T& back() const;
+
+		bool empty() const noexcept;
+		size_t size() const noexcept;
+		void clear() noexcept;
+		void swap(SegmentedStorage& storage) noexcept;
+
+		// Puts all items of storage on top of ours keeping their order, storage is left empty.
+		void Splice(SegmentedStorage&& storage) noexcept;
+		// Preallocates chunks for itemsCount items and keeps them on pop, so a storage which stays
+		// within the reserve never reaches the allocator again.
+		void Reserve(size_t itemsCount);
+		// Frees every unused chunk and drops the reservation.
+		void ShrinkToFit() noexcept;
+		// Items which fit into the chunks allocated now, used and free ones.
+		size_t Capacity() const noexcept;
+		size_t MemoryUsage() const noexcept;
+
+		template<typename Function>
+		void ForEachFromBottom(Function&& function) const;
+		// Visits at most maxCount items starting with the top one.
+		template<typename Function>
+		void ForEachFromTop(size_t maxCount, Function&& function) const;
+
+	private:
+		struct Chunk
+		{
+			T* Items() noexcept
+			{
+				return reinterpret_cast<T*>(buffer);
+			}
+
+			Chunk* previous;
+			uint32_t count;
+			alignas(T) unsigned char buffer[sizeof(T) * ChunkCapacity];
+		};
+
+		using ChunkAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Chunk>;
+
+		Chunk* PrepareChunkForPush();
+		Chunk* AllocateChunk();
+		void ReleaseChunk(Chunk* chunk) noexcept;
+		void RecycleChunk(Chunk* chunk) noexcept;
+		void FreeChunk(Chunk* chunk) noexcept;
+
+		ChunkAllocator chunkAllocator;
+		Chunk* top;
+		Chunk* bottom;
+		// emptied chunks, at least one is kept so push/pop on a chunk boundary does not hit the allocator
+		Chunk* freeChunks;
+		uint32_t freeChunksCount;
+		uint32_t chunksCount;
+		uint32_t reservedChunksCount;
+		size_t itemsCount;
+	};
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	SegmentedStorage<T, ChunkCapacity, Allocator>::SegmentedStorage() noexcept
+		: SegmentedStorage(Allocator())
+	{
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	SegmentedStorage<T, ChunkCapacity, Allocator>::SegmentedStorage(const Allocator& allocator) noexcept
+		: chunkAllocator(allocator),
+		top(nullptr),
+		bottom(nullptr),
+		freeChunks(nullptr),
+		freeChunksCount(0),
+		chunksCount(0),
+		reservedChunksCount(0),
+		itemsCount(0)
+	{
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	SegmentedStorage<T, ChunkCapacity, Allocator>::SegmentedStorage(const SegmentedStorage& storage)
+		: SegmentedStorage(std::allocator_traits<ChunkAllocator>::select_on_container_copy_construction(storage.chunkAllocator))
+	{
+		storage.ForEachFromBottom([this](const T& item) { push_back(item); });
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	SegmentedStorage<T, ChunkCapacity, Allocator>::SegmentedStorage(SegmentedStorage&& storage) noexcept
+		: SegmentedStorage(storage.chunkAllocator)
+	{
+		swap(storage);
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	SegmentedStorage<T, ChunkCapacity, Allocator>::~SegmentedStorage()
+	{
+		clear();
+		ShrinkToFit();
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	SegmentedStorage<T, ChunkCapacity, Allocator>& SegmentedStorage<T, ChunkCapacity, Allocator>::operator=(const SegmentedStorage& storage)
+	{
+		if (this != &storage)
+		{
+			SegmentedStorage copy(storage);
+			swap(copy);
+		}
+		return *this;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	SegmentedStorage<T, ChunkCapacity, Allocator>& SegmentedStorage<T, ChunkCapacity, Allocator>::operator=(SegmentedStorage&& storage) noexcept
+	{
+		if (this != &storage)
+		{
+			clear();
+			swap(storage);
+		}
+		return *this;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::push_back(const T& item)
+	{
+		emplace_back(item);
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::push_back(T&& item)
+	{
+		emplace_back(std::move(item));
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	template<typename... Args>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::emplace_back(Args&&... args)
+	{
+		auto chunk = PrepareChunkForPush();
+		try
+		{
+			new (chunk->Items() + chunk->count) T(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			if (chunk->count == 0)
+			{
+				ReleaseChunk(chunk);
+			}
+			throw;
+		}
+		++chunk->count;
+		++itemsCount;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::pop_back()
+	{
+		top->Items()[top->count - 1].~T();
+		--top->count;
+		--itemsCount;
+		if (top->count == 0)
+		{
+			ReleaseChunk(top);
+		}
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	T& SegmentedStorage<T, ChunkCapacity, Allocator>::back()
+	{
+		return top->Items()[top->count - 1];
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	const T& SegmentedStorage<T, ChunkCapacity, Allocator>::back() const
+	{
+		return top->Items()[top->count - 1];
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	bool SegmentedStorage<T, ChunkCapacity, Allocator>::empty() const noexcept
+	{
+		return itemsCount == 0;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	size_t SegmentedStorage<T, ChunkCapacity, Allocator>::size() const noexcept
+	{
+		return itemsCount;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::clear() noexcept
+	{
+		while (top)
+		{
+			auto chunk = top;
+			for (uint32_t index = 0; index < chunk->count; ++index)
+			{
+				chunk->Items()[index].~T();
+			}
+			top = chunk->previous;
+			RecycleChunk(chunk);
+		}
+		bottom = nullptr;
+		itemsCount = 0;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::swap(SegmentedStorage& storage) noexcept
+	{
+		std::swap(chunkAllocator, storage.chunkAllocator);
+		std::swap(top, storage.top);
+		std::swap(bottom, storage.bottom);
+		std::swap(freeChunks, storage.freeChunks);
+		std::swap(freeChunksCount, storage.freeChunksCount);
+		std::swap(chunksCount, storage.chunksCount);
+		std::swap(reservedChunksCount, storage.reservedChunksCount);
+		std::swap(itemsCount, storage.itemsCount);
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::Splice(SegmentedStorage&& storage) noexcept
+	{
+		if (this == &storage || storage.empty())
+		{
+			return;
+		}
+
+		// a single small chunk is cheaper to move into our top than to leave half empty in the middle
+		if (std::is_nothrow_move_constructible<T>::value && top && storage.top == storage.bottom
+			&& top->count + storage.top->count <= ChunkCapacity)
+		{
+			auto items = storage.top->Items();
+			for (uint32_t index = 0; index < storage.top->count; ++index)
+			{
+				new (top->Items() + top->count) T(std::move(items[index]));
+				items[index].~T();
+				++top->count;
+			}
+			itemsCount += storage.itemsCount;
+			storage.top->count = 0;
+			storage.ReleaseChunk(storage.top);
+			storage.itemsCount = 0;
+			return;
+		}
+
+		if (top)
+		{
+			storage.bottom->previous = top;
+		}
+		else
+		{
+			bottom = storage.bottom;
+		}
+		top = storage.top;
+		itemsCount += storage.itemsCount;
+
+		const auto usedChunksCount = storage.chunksCount - storage.freeChunksCount;
+		chunksCount += usedChunksCount;
+		storage.chunksCount -= usedChunksCount;
+
+		storage.top = nullptr;
+		storage.bottom = nullptr;
+		storage.itemsCount = 0;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::Reserve(size_t itemsCount)
+	{
+		reservedChunksCount = static_cast<uint32_t>((itemsCount + ChunkCapacity - 1) / ChunkCapacity);
+		while (chunksCount < reservedChunksCount)
+		{
+			auto chunk = AllocateChunk();
+			chunk->previous = freeChunks;
+			freeChunks = chunk;
+			++freeChunksCount;
+		}
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::ShrinkToFit() noexcept
+	{
+		reservedChunksCount = 0;
+		while (freeChunks)
+		{
+			auto chunk = freeChunks;
+			freeChunks = chunk->previous;
+			FreeChunk(chunk);
+		}
+		freeChunksCount = 0;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	size_t SegmentedStorage<T, ChunkCapacity, Allocator>::Capacity() const noexcept
+	{
+		return static_cast<size_t>(chunksCount) * ChunkCapacity;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	size_t SegmentedStorage<T, ChunkCapacity, Allocator>::MemoryUsage() const noexcept
+	{
+		return sizeof(*this) + static_cast<size_t>(chunksCount) * sizeof(Chunk);
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	template<typename Function>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::ForEachFromBottom(Function&& function) const
+	{
+		std::vector<Chunk*> chunks;
+		for (auto chunk = top; chunk; chunk = chunk->previous)
+		{
+			chunks.push_back(chunk);
+		}
+		for (auto chunk = chunks.rbegin(); chunk != chunks.rend(); ++chunk)
+		{
+			const T* items = (*chunk)->Items();
+			for (uint32_t index = 0; index < (*chunk)->count; ++index)
+			{
+				function(items[index]);
+			}
+		}
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	template<typename Function>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::ForEachFromTop(size_t maxCount, Function&& function) const
+	{
+		for (auto chunk = top; chunk && maxCount > 0; chunk = chunk->previous)
+		{
+			const T* items = chunk->Items();
+			for (auto index = chunk->count; index > 0 && maxCount > 0; --index, --maxCount)
+			{
+				function(items[index - 1]);
+			}
+		}
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	typename SegmentedStorage<T, ChunkCapacity, Allocator>::Chunk* SegmentedStorage<T, ChunkCapacity, Allocator>::PrepareChunkForPush()
+	{
+		if (top && top->count < ChunkCapacity)
+		{
+			return top;
+		}
+
+		Chunk* chunk;
+		if (freeChunks)
+		{
+			chunk = freeChunks;
+			freeChunks = chunk->previous;
+			--freeChunksCount;
+		}
+		else
+		{
+			chunk = AllocateChunk();
+		}
+		chunk->previous = top;
+		chunk->count = 0;
+		if (!top)
+		{
+			bottom = chunk;
+		}
+		top = chunk;
+		return chunk;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	typename SegmentedStorage<T, ChunkCapacity, Allocator>::Chunk* SegmentedStorage<T, ChunkCapacity, Allocator>::AllocateChunk()
+	{
+		// default initialized, value initialization through the allocator would zero the whole buffer
+		auto chunk = new (std::allocator_traits<ChunkAllocator>::allocate(chunkAllocator, 1)) Chunk;
+		++chunksCount;
+		return chunk;
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::ReleaseChunk(Chunk* chunk) noexcept
+	{
+		// only the emptied top chunk is ever released
+		top = chunk->previous;
+		if (!top)
+		{
+			bottom = nullptr;
+		}
+		RecycleChunk(chunk);
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::RecycleChunk(Chunk* chunk) noexcept
+	{
+		if (freeChunksCount == 0 || chunksCount <= reservedChunksCount)
+		{
+			chunk->previous = freeChunks;
+			freeChunks = chunk;
+			++freeChunksCount;
+		}
+		else
+		{
+			FreeChunk(chunk);
+		}
+	}
+
+	template<typename T, uint32_t ChunkCapacity, typename Allocator>
+	void SegmentedStorage<T, ChunkCapacity, Allocator>::FreeChunk(Chunk* chunk) noexcept
+	{
+		std::allocator_traits<ChunkAllocator>::deallocate(chunkAllocator, chunk, 1);
+		--chunksCount;
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "ThreadSafeException.h"
+#include "RWLockStack.h"
+#include "ThreadNumber.h"
+
+namespace ThreadSafeStructs
+{
+	// Set of RWLockStack shards. Every thread pushes to and pops from its own shard and steals from
+	// the others only when its shard is empty, so threads rarely meet on the same mutex.
+	// Order is LIFO per shard only, there is no global LIFO order across shards.
+	template<typename T, typename LockPolicy = DefaultLockPolicy, typename Allocator = std::allocator<T>>
+	class ShardedStack
+	{
+	public:
+		explicit ShardedStack(const uint32_t shardsCount = std::thread::hardware_concurrency());
+		ShardedStack(const ShardedStack<T, LockPolicy, Allocator>& stack) = delete;
+		ShardedStack<T, LockPolicy, Allocator>& operator=(const ShardedStack<T, LockPolicy, Allocator>& stack) = delete;
+
+		ShardedStack<T, LockPolicy, Allocator>& Push(const T& item);
+		ShardedStack<T, LockPolicy, Allocator>& Push(T&& item);
+
+		T TryPop();
+		bool TryPop(T& item);
+
+		bool Empty() const noexcept;
+		// Sum of the shard sizes, approximate while other threads push or pop.
+		uint32_t Size() const noexcept;
+		uint32_t ShardsCount() const noexcept;
+
+	private:
+		RWLockStack<T, LockPolicy, Allocator>& GetLocalShard() noexcept;
+		uint32_t GetLocalShardIndex() const noexcept;
+
+		const uint32_t shardsCount;
+		std::unique_ptr<RWLockStack<T, LockPolicy, Allocator>[]> shards;
+	};
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	ShardedStack<T, LockPolicy, Allocator>::ShardedStack(const uint32_t shardsCount)
+		: shardsCount(std::max(shardsCount, 1u)),
+		shards(new RWLockStack<T, LockPolicy, Allocator>[std::max(shardsCount, 1u)])
+	{
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	ShardedStack<T, LockPolicy, Allocator>& ShardedStack<T, LockPolicy, Allocator>::Push(const T& item)
+	{
+		GetLocalShard().Push(item);
+		return *this;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	ShardedStack<T, LockPolicy, Allocator>& ShardedStack<T, LockPolicy, Allocator>::Push(T&& item)
+	{
+		GetLocalShard().Push(std::move(item));
+		return *this;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	T ShardedStack<T, LockPolicy, Allocator>::TryPop()
+	{
+		const auto localShardIndex = GetLocalShardIndex();
+		for (uint32_t offset = 0; offset < shardsCount; ++offset)
+		{
+			auto& shard = shards[(localShardIndex + offset) % shardsCount];
+			if (shard.Empty())
+			{
+				continue;
+			}
+			try
+			{
+				return shard.TryPop();
+			}
+			catch (const ThreadSafeStructs::ThreadSafetyException&)
+			{
+				// emptied by another thread after the check, keep stealing
+			}
+		}
+		throw ThreadSafeStructs::ThreadSafetyException("Item can not be poped from stack, stack is empty.");
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	bool ShardedStack<T, LockPolicy, Allocator>::TryPop(T& item)
+	{
+		const auto localShardIndex = GetLocalShardIndex();
+		for (uint32_t offset = 0; offset < shardsCount; ++offset)
+		{
+			auto& shard = shards[(localShardIndex + offset) % shardsCount];
+			if (!shard.Empty() && shard.TryPop(item))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	bool ShardedStack<T, LockPolicy, Allocator>::Empty() const noexcept
+	{
+		for (uint32_t index = 0; index < shardsCount; ++index)
+		{
+			if (!shards[index].Empty())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	uint32_t ShardedStack<T, LockPolicy, Allocator>::Size() const noexcept
+	{
+		uint32_t size = 0;
+		for (uint32_t index = 0; index < shardsCount; ++index)
+		{
+			size += shards[index].Size();
+		}
+		return size;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	uint32_t ShardedStack<T, LockPolicy, Allocator>::ShardsCount() const noexcept
+	{
+		return shardsCount;
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	RWLockStack<T, LockPolicy, Allocator>& ShardedStack<T, LockPolicy, Allocator>::GetLocalShard() noexcept
+	{
+		return shards[GetLocalShardIndex()];
+	}
+
+	template<typename T, typename LockPolicy, typename Allocator>
+	uint32_t ShardedStack<T, LockPolicy, Allocator>::GetLocalShardIndex() const noexcept
+	{
+		return GetCurrentThreadNumber() % shardsCount;
+	}
+}
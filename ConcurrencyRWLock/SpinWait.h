@@ -0,0 +1,44 @@
+#pragma once
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+namespace ThreadSafeStructs
+{
+	// Hints the core that we are in a spin loop (PAUSE on x86), so the sibling hyper-thread
+	// is not starved and the loop exit does not pay for a memory order violation.
+	inline void CpuRelax() noexcept
+	{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+		_mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+
+	// Spins with CpuRelax for a while and then yields the time slice, so a waiter does not burn
+	// the whole quantum of the core the lock owner was preempted on.
+	class SpinWait
+	{
+	public:
+		void SpinOnce() noexcept
+		{
+			if (spinsCount < SPINS_BEFORE_YIELD)
+			{
+				++spinsCount;
+				CpuRelax();
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+	private:
+		static const uint32_t SPINS_BEFORE_YIELD = 64;
+
+		uint32_t spinsCount = 0;
+	};
+}
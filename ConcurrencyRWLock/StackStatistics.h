@@ -0,0 +1,304 @@
+#pragma once
+#include "ThreadSafeException.h"
+#include "LockPolicies.h"
+#include "CacheLine.h"
+#include "ThreadNumber.h"
+
+namespace ThreadSafeStructs
+{
+	enum StatisticsCounter : uint32_t
+	{
+		LOCK_ACQUISITIONS,
+		CONTENDED_ACQUISITIONS,
+		LOCK_WAIT_NANOSECONDS,
+		// exclusive holds only, shared holders do not own a single acquisition time
+		LOCK_HOLD_NANOSECONDS,
+		WAIT_BLOCKS,
+		WAKE_UPS,
+		NOTIFIES,
+		// Push and TryPop calls completed through the elimination array, without the lock
+		ELIMINATED_OPERATIONS,
+		STATISTICS_COUNTERS_COUNT
+	};
+
+	// Values of all counters at one moment, rendered for scrapers.
+	struct StackStatsSnapshot
+	{
+		enum class Format
+		{
+			PROMETHEUS,
+			JSON
+		};
+
+		uint64_t counters[STATISTICS_COUNTERS_COUNT] = {};
+		uint64_t peakSize = 0;
+
+		// Prometheus text exposition format, every metric name starts with metricsPrefix.
+		std::string ToPrometheus(const std::string& metricsPrefix = "rwlockstack") const;
+		std::string ToJson() const;
+		void WriteToFile(const std::string& path, const Format format) const;
+	};
+
+	// Counters split in per-thread shards, so recording an event does not bounce one cache line
+	// between all threads. Shards are summed up only when a snapshot is taken.
+	class StackStatistics
+	{
+	public:
+		StackStatistics() noexcept;
+		StackStatistics(const StackStatistics&) = delete;
+		StackStatistics& operator=(const StackStatistics&) = delete;
+
+		void Add(const StatisticsCounter counter, const uint64_t value = 1) noexcept;
+		void UpdatePeakSize(const uint64_t size) noexcept;
+		StackStatsSnapshot Snapshot() const noexcept;
+
+	private:
+		static const uint32_t SHARDS_COUNT = 16;
+
+		struct alignas(CACHE_LINE_SIZE) Shard
+		{
+			std::atomic<uint64_t> counters[STATISTICS_COUNTERS_COUNT];
+		};
+
+		Shard shards[SHARDS_COUNT];
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> peakSize;
+	};
+
+	// Lock policy which wraps another one and records acquisitions, contention, wait and hold
+	// times. Choosing it is the opt-in: stacks with a plain policy carry no statistics at all.
+	template<typename LockPolicy>
+	class InstrumentedLock
+	{
+	public:
+		InstrumentedLock() noexcept;
+		InstrumentedLock(const InstrumentedLock&) = delete;
+		InstrumentedLock& operator=(const InstrumentedLock&) = delete;
+
+		void lock();
+		bool try_lock();
+		void unlock();
+		// For a caller whose try_lock failed and which did other work before blocking: the
+		// acquisition counts as contended, waiting since that failed try.
+		void LockAfterFailedTry(const std::chrono::steady_clock::time_point failedTryAt);
+
+		void lock_shared() requires IsSharedLockable<LockPolicy>::value;
+		bool try_lock_shared() requires IsSharedLockable<LockPolicy>::value;
+		void unlock_shared() requires IsSharedLockable<LockPolicy>::value;
+
+		StackStatistics& Statistics() noexcept;
+		const StackStatistics& Statistics() const noexcept;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		static uint64_t GetNanosecondsSince(const Clock::time_point start) noexcept;
+
+		LockPolicy lockPolicy;
+		// written by the exclusive owner only
+		Clock::time_point acquiredAt;
+		StackStatistics statistics;
+	};
+
+	// True for InstrumentedLock and for wrappers around it which pass its statistics on.
+	template<typename Lock, typename = void>
+	struct HasLockStatistics : std::false_type
+	{
+	};
+
+	template<typename Lock>
+	struct HasLockStatistics<Lock, std::void_t<decltype(std::declval<const Lock&>().Statistics())>> : std::true_type
+	{
+	};
+
+	inline std::string StackStatsSnapshot::ToPrometheus(const std::string& metricsPrefix) const
+	{
+		static const char* const COUNTER_NAMES[STATISTICS_COUNTERS_COUNT] = {
+			"lock_acquisitions_total",
+			"contended_acquisitions_total",
+			"lock_wait_nanoseconds_total",
+			"lock_hold_nanoseconds_total",
+			"wait_blocks_total",
+			"wake_ups_total",
+			"notifies_total",
+			"eliminated_operations_total"
+		};
+
+		std::ostringstream text;
+		for (uint32_t counter = 0; counter < STATISTICS_COUNTERS_COUNT; ++counter)
+		{
+			const auto name = metricsPrefix + "_" + COUNTER_NAMES[counter];
+			text << "# TYPE " << name << " counter\n" << name << " " << counters[counter] << "\n";
+		}
+		const auto peakSizeName = metricsPrefix + "_peak_size";
+		text << "# TYPE " << peakSizeName << " gauge\n" << peakSizeName << " " << peakSize << "\n";
+		return text.str();
+	}
+
+	inline std::string StackStatsSnapshot::ToJson() const
+	{
+		static const char* const COUNTER_NAMES[STATISTICS_COUNTERS_COUNT] = {
+			"lockAcquisitions",
+			"contendedAcquisitions",
+			"lockWaitNanoseconds",
+			"lockHoldNanoseconds",
+			"waitBlocks",
+			"wakeUps",
+			"notifies",
+			"eliminatedOperations"
+		};
+
+		std::ostringstream text;
+		text << "{";
+		for (uint32_t counter = 0; counter < STATISTICS_COUNTERS_COUNT; ++counter)
+		{
+			text << "\"" << COUNTER_NAMES[counter] << "\":" << counters[counter] << ",";
+		}
+		text << "\"peakSize\":" << peakSize << "}";
+		return text.str();
+	}
+
+	inline void StackStatsSnapshot::WriteToFile(const std::string& path, const Format format) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		file << (format == Format::PROMETHEUS ? ToPrometheus() : ToJson());
+		if (!file)
+		{
+			throw ThreadSafeStructs::ThreadSafetyException("Statistics can not be written to " + path + ".");
+		}
+	}
+
+	inline StackStatistics::StackStatistics() noexcept
+		: peakSize(0)
+	{
+		for (auto& shard : shards)
+		{
+			for (auto& counter : shard.counters)
+			{
+				counter.store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	inline void StackStatistics::Add(const StatisticsCounter counter, const uint64_t value) noexcept
+	{
+		shards[GetCurrentThreadNumber() % SHARDS_COUNT].counters[counter].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	inline void StackStatistics::UpdatePeakSize(const uint64_t size) noexcept
+	{
+		auto currentPeakSize = peakSize.load(std::memory_order_relaxed);
+		while (size > currentPeakSize && !peakSize.compare_exchange_weak(currentPeakSize, size, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	inline StackStatsSnapshot StackStatistics::Snapshot() const noexcept
+	{
+		StackStatsSnapshot snapshot;
+		for (const auto& shard : shards)
+		{
+			for (uint32_t counter = 0; counter < STATISTICS_COUNTERS_COUNT; ++counter)
+			{
+				snapshot.counters[counter] += shard.counters[counter].load(std::memory_order_relaxed);
+			}
+		}
+		snapshot.peakSize = peakSize.load(std::memory_order_relaxed);
+		return snapshot;
+	}
+
+	template<typename LockPolicy>
+	InstrumentedLock<LockPolicy>::InstrumentedLock() noexcept
+	{
+	}
+
+	template<typename LockPolicy>
+	void InstrumentedLock<LockPolicy>::lock()
+	{
+		if (!lockPolicy.try_lock())
+		{
+			const auto waitStart = Clock::now();
+			lockPolicy.lock();
+			statistics.Add(CONTENDED_ACQUISITIONS);
+			statistics.Add(LOCK_WAIT_NANOSECONDS, GetNanosecondsSince(waitStart));
+		}
+		statistics.Add(LOCK_ACQUISITIONS);
+		acquiredAt = Clock::now();
+	}
+
+	template<typename LockPolicy>
+	bool InstrumentedLock<LockPolicy>::try_lock()
+	{
+		if (!lockPolicy.try_lock())
+		{
+			return false;
+		}
+		statistics.Add(LOCK_ACQUISITIONS);
+		acquiredAt = Clock::now();
+		return true;
+	}
+
+	template<typename LockPolicy>
+	void InstrumentedLock<LockPolicy>::LockAfterFailedTry(const std::chrono::steady_clock::time_point failedTryAt)
+	{
+		lockPolicy.lock();
+		statistics.Add(CONTENDED_ACQUISITIONS);
+		statistics.Add(LOCK_WAIT_NANOSECONDS, GetNanosecondsSince(failedTryAt));
+		statistics.Add(LOCK_ACQUISITIONS);
+		acquiredAt = Clock::now();
+	}
+
+	template<typename LockPolicy>
+	void InstrumentedLock<LockPolicy>::unlock()
+	{
+		statistics.Add(LOCK_HOLD_NANOSECONDS, GetNanosecondsSince(acquiredAt));
+		lockPolicy.unlock();
+	}
+
+	template<typename LockPolicy>
+	void InstrumentedLock<LockPolicy>::lock_shared() requires IsSharedLockable<LockPolicy>::value
+	{
+		if (!lockPolicy.try_lock_shared())
+		{
+			const auto waitStart = Clock::now();
+			lockPolicy.lock_shared();
+			statistics.Add(CONTENDED_ACQUISITIONS);
+			statistics.Add(LOCK_WAIT_NANOSECONDS, GetNanosecondsSince(waitStart));
+		}
+		statistics.Add(LOCK_ACQUISITIONS);
+	}
+
+	template<typename LockPolicy>
+	bool InstrumentedLock<LockPolicy>::try_lock_shared() requires IsSharedLockable<LockPolicy>::value
+	{
+		if (!lockPolicy.try_lock_shared())
+		{
+			return false;
+		}
+		statistics.Add(LOCK_ACQUISITIONS);
+		return true;
+	}
+
+	template<typename LockPolicy>
+	void InstrumentedLock<LockPolicy>::unlock_shared() requires IsSharedLockable<LockPolicy>::value
+	{
+		lockPolicy.unlock_shared();
+	}
+
+	template<typename LockPolicy>
+	StackStatistics& InstrumentedLock<LockPolicy>::Statistics() noexcept
+	{
+		return statistics;
+	}
+
+	template<typename LockPolicy>
+	const StackStatistics& InstrumentedLock<LockPolicy>::Statistics() const noexcept
+	{
+		return statistics;
+	}
+
+	template<typename LockPolicy>
+	uint64_t InstrumentedLock<LockPolicy>::GetNanosecondsSince(const Clock::time_point start) noexcept
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+	}
+}
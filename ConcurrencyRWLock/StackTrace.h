@@ -0,0 +1,514 @@
+#pragma once
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+#include "ThreadSafeException.h"
+#include "LockPolicies.h"
+#include "StackStatistics.h"
+#include "ThreadNumber.h"
+
+namespace ThreadSafeStructs
+{
+	enum TraceEventType : uint32_t
+	{
+		PUSH_EVENT,
+		POP_EVENT,
+		LOCK_ACQUIRE_START_EVENT,
+		LOCK_ACQUIRE_END_EVENT,
+		LOCK_RELEASE_EVENT,
+		SHARED_LOCK_ACQUIRE_START_EVENT,
+		SHARED_LOCK_ACQUIRE_END_EVENT,
+		SHARED_LOCK_RELEASE_EVENT,
+		WAIT_EVENT,
+		WAKE_EVENT,
+		// a contended Push/TryPop trying the elimination array, the end value is 1 if it met a partner
+		ELIMINATION_START_EVENT,
+		ELIMINATION_END_EVENT
+	};
+
+	// Time stamp counter on x86, steady clock nanoseconds elsewhere. Converted to wall time only
+	// when the trace is exported.
+	inline uint64_t ReadTraceTimestamp() noexcept
+	{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+		return __rdtsc();
+#elif defined(__i386__) || defined(__x86_64__)
+		return __builtin_ia32_rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	// Ring of the last TRACE_BUFFER_CAPACITY events of one thread. Only the owning thread writes,
+	// the exporter reads concurrently and drops the events overwritten while it copied them.
+	class TraceBuffer
+	{
+	public:
+		static constexpr uint64_t TRACE_BUFFER_CAPACITY = 8192;
+
+		struct Event
+		{
+			uint64_t timestamp = 0;
+			uintptr_t object = 0;
+			TraceEventType type = PUSH_EVENT;
+			uint32_t threadNumber = 0;
+			uint32_t value = 0;
+		};
+
+		TraceBuffer() noexcept;
+
+		void Record(const TraceEventType type, const void* object, const uint32_t value) noexcept;
+		void ReadEvents(std::vector<Event>& events) const;
+		void Clear() noexcept;
+
+		// The acquiring thread becomes the only writer, its number goes into every event.
+		bool TryAcquire(const uint32_t ownerThreadNumber) noexcept;
+		void Release() noexcept;
+
+	private:
+		// Every slot is a seqlock: sequence is zeroed before the fields are rewritten and set to
+		// index + 1 once they are complete, a reader keeps the copy only if it saw index + 1 on
+		// both sides of it. The fields are atomics, so the concurrent copy is not a data race.
+		struct StoredEvent
+		{
+			std::atomic<uint64_t> sequence;
+			std::atomic<uint64_t> timestamp;
+			std::atomic<uint64_t> object;
+			// type in the low 8 bits, thread number in the next 24, value in the high 32
+			std::atomic<uint64_t> typeThreadAndValue;
+		};
+
+		alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> eventsCount;
+		std::atomic<bool> isOwned;
+		uint64_t ownerThreadNumber;
+		std::unique_ptr<StoredEvent[]> events;
+	};
+
+	// Process wide collection of the per-thread trace buffers. Buffers of finished threads are
+	// kept, with their events, and handed over to new threads, so short lived threads do not
+	// pile up buffers. Instance() is intentionally leaked, threads may trace during exit.
+	class Tracer
+	{
+	public:
+		static Tracer& Instance();
+
+		// Static, the hot path reads only a thread_local pointer, neither Instance() nor a
+		// thread_local with an initialization guard.
+		static void Record(const TraceEventType type, const void* object, const uint32_t value = 0) noexcept;
+		// Chrome trace event format, loads in chrome://tracing and Perfetto. Lock waits, lock holds
+		// and waits for items become complete events, pushes and pops instant ones.
+		std::string ExportChromeTrace() const;
+		void WriteChromeTrace(const std::string& path) const;
+		// Drops recorded events, for use while no traced thread is running.
+		void Clear() noexcept;
+
+	private:
+		class ThreadBufferOwner
+		{
+		public:
+			ThreadBufferOwner() noexcept;
+			~ThreadBufferOwner();
+
+			TraceBuffer* buffer;
+		};
+
+		Tracer();
+
+		static void RecordToNewBuffer(const TraceEventType type, const void* object, const uint32_t value) noexcept;
+		TraceBuffer* AcquireBuffer();
+
+		// buffer of the calling thread, owned by the ThreadBufferOwner of RecordToNewBuffer
+		static inline thread_local TraceBuffer* threadBuffer = nullptr;
+		// set once the owner released the buffer at thread exit, later events are dropped
+		static inline thread_local bool isThreadBufferReleased = false;
+
+		const uint64_t startTimestamp;
+		const std::chrono::steady_clock::time_point startTime;
+		mutable std::mutex buffersMutex;
+		std::vector<std::unique_ptr<TraceBuffer>> buffers;
+	};
+
+	// Lock policy which wraps another one and traces every acquisition and release of it,
+	// including those a condition variable makes while waiting. Choosing it is the opt-in,
+	// stacks with another policy record no events and pay nothing.
+	template<typename LockPolicy>
+	class TracedLock
+	{
+	public:
+		TracedLock() noexcept;
+		TracedLock(const TracedLock&) = delete;
+		TracedLock& operator=(const TracedLock&) = delete;
+
+		void lock();
+		bool try_lock();
+		void unlock();
+		void LockAfterFailedTry(const std::chrono::steady_clock::time_point failedTryAt) requires HasLockStatistics<LockPolicy>::value;
+
+		void lock_shared() requires IsSharedLockable<LockPolicy>::value;
+		bool try_lock_shared() requires IsSharedLockable<LockPolicy>::value;
+		void unlock_shared() requires IsSharedLockable<LockPolicy>::value;
+
+		// TracedLock<InstrumentedLock<...>> keeps the statistics
+		StackStatistics& Statistics() noexcept requires HasLockStatistics<LockPolicy>::value;
+		const StackStatistics& Statistics() const noexcept requires HasLockStatistics<LockPolicy>::value;
+
+	private:
+		LockPolicy lockPolicy;
+	};
+
+	template<typename Lock>
+	struct IsTracedLock : std::false_type
+	{
+	};
+
+	template<typename LockPolicy>
+	struct IsTracedLock<TracedLock<LockPolicy>> : std::true_type
+	{
+	};
+
+	inline TraceBuffer::TraceBuffer() noexcept
+		: eventsCount(0),
+		isOwned(false),
+		ownerThreadNumber(0),
+		events(new StoredEvent[TRACE_BUFFER_CAPACITY])
+	{
+	}
+
+	inline void TraceBuffer::Record(const TraceEventType type, const void* object, const uint32_t value) noexcept
+	{
+		const auto index = eventsCount.load(std::memory_order_relaxed);
+		auto& event = events[index % TRACE_BUFFER_CAPACITY];
+		event.sequence.store(0, std::memory_order_relaxed);
+		// keeps the field stores below from becoming visible before the slot is invalidated
+		std::atomic_thread_fence(std::memory_order_release);
+		event.timestamp.store(ReadTraceTimestamp(), std::memory_order_relaxed);
+		event.object.store(reinterpret_cast<uintptr_t>(object), std::memory_order_relaxed);
+		event.typeThreadAndValue.store(static_cast<uint64_t>(type)
+			| (ownerThreadNumber << 8)
+			| (static_cast<uint64_t>(value) << 32), std::memory_order_relaxed);
+		event.sequence.store(index + 1, std::memory_order_release);
+		eventsCount.store(index + 1, std::memory_order_release);
+	}
+
+	inline void TraceBuffer::ReadEvents(std::vector<Event>& readEvents) const
+	{
+		const auto lastIndex = eventsCount.load(std::memory_order_acquire);
+		const auto firstIndex = lastIndex > TRACE_BUFFER_CAPACITY ? lastIndex - TRACE_BUFFER_CAPACITY : 0;
+		for (auto index = firstIndex; index < lastIndex; ++index)
+		{
+			const auto& storedEvent = events[index % TRACE_BUFFER_CAPACITY];
+			if (storedEvent.sequence.load(std::memory_order_acquire) != index + 1)
+			{
+				// the owner already started writing a newer event into the slot
+				continue;
+			}
+			const auto typeThreadAndValue = storedEvent.typeThreadAndValue.load(std::memory_order_relaxed);
+			Event event;
+			event.timestamp = storedEvent.timestamp.load(std::memory_order_relaxed);
+			event.object = static_cast<uintptr_t>(storedEvent.object.load(std::memory_order_relaxed));
+			// keeps the field loads above from moving below the sequence check
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (storedEvent.sequence.load(std::memory_order_relaxed) != index + 1)
+			{
+				continue;
+			}
+			event.type = static_cast<TraceEventType>(typeThreadAndValue & 0xFF);
+			event.threadNumber = static_cast<uint32_t>((typeThreadAndValue >> 8) & 0xFFFFFF);
+			event.value = static_cast<uint32_t>(typeThreadAndValue >> 32);
+			readEvents.push_back(event);
+		}
+	}
+
+	inline void TraceBuffer::Clear() noexcept
+	{
+		eventsCount.store(0, std::memory_order_release);
+	}
+
+	inline bool TraceBuffer::TryAcquire(const uint32_t ownerThreadNumber) noexcept
+	{
+		bool expected = false;
+		if (!isOwned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+		{
+			return false;
+		}
+		this->ownerThreadNumber = ownerThreadNumber & 0xFFFFFF;
+		return true;
+	}
+
+	inline void TraceBuffer::Release() noexcept
+	{
+		isOwned.store(false, std::memory_order_release);
+	}
+
+	inline Tracer& Tracer::Instance()
+	{
+		static Tracer* tracer = new Tracer();
+		return *tracer;
+	}
+
+	inline Tracer::Tracer()
+		: startTimestamp(ReadTraceTimestamp()),
+		startTime(std::chrono::steady_clock::now())
+	{
+	}
+
+	inline void Tracer::Record(const TraceEventType type, const void* object, const uint32_t value) noexcept
+	{
+		if (threadBuffer)
+		{
+			threadBuffer->Record(type, object, value);
+			return;
+		}
+		RecordToNewBuffer(type, object, value);
+	}
+
+	inline void Tracer::RecordToNewBuffer(const TraceEventType type, const void* object, const uint32_t value) noexcept
+	{
+		if (isThreadBufferReleased)
+		{
+			return;
+		}
+		thread_local ThreadBufferOwner owner;
+		try
+		{
+			owner.buffer = Instance().AcquireBuffer();
+		}
+		catch (...)
+		{
+			// out of memory, this event is lost and the next one tries again
+			return;
+		}
+		threadBuffer = owner.buffer;
+		threadBuffer->Record(type, object, value);
+	}
+
+	inline TraceBuffer* Tracer::AcquireBuffer()
+	{
+		const auto threadNumber = GetCurrentThreadNumber();
+		const std::lock_guard<std::mutex> lock(buffersMutex);
+		for (auto& buffer : buffers)
+		{
+			if (buffer->TryAcquire(threadNumber))
+			{
+				return buffer.get();
+			}
+		}
+		buffers.push_back(std::make_unique<TraceBuffer>());
+		buffers.back()->TryAcquire(threadNumber);
+		return buffers.back().get();
+	}
+
+	inline void Tracer::Clear() noexcept
+	{
+		const std::lock_guard<std::mutex> lock(buffersMutex);
+		for (auto& buffer : buffers)
+		{
+			buffer->Clear();
+		}
+	}
+
+	inline std::string Tracer::ExportChromeTrace() const
+	{
+		std::vector<TraceBuffer::Event> events;
+		{
+			const std::lock_guard<std::mutex> lock(buffersMutex);
+			for (const auto& buffer : buffers)
+			{
+				buffer->ReadEvents(events);
+			}
+		}
+
+		// time stamp counter ticks per microsecond, measured over the tracer lifetime
+		const auto elapsedTicks = static_cast<double>(ReadTraceTimestamp() - startTimestamp);
+		const auto elapsedMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+		const auto ticksPerMicrosecond = elapsedMicroseconds > 0.0 && elapsedTicks > 0.0 ? elapsedTicks / elapsedMicroseconds : 1.0;
+		auto toMicroseconds = [this, ticksPerMicrosecond](const uint64_t timestamp)
+			{
+				return static_cast<double>(static_cast<int64_t>(timestamp - startTimestamp)) / ticksPerMicrosecond;
+			};
+
+		std::stable_sort(events.begin(), events.end(), [](const TraceBuffer::Event& first, const TraceBuffer::Event& second)
+			{
+				return first.threadNumber != second.threadNumber ? first.threadNumber < second.threadNumber : first.timestamp < second.timestamp;
+			});
+
+		std::ostringstream json;
+		json << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		auto isFirstEvent = true;
+		auto writeEvent = [&json, &isFirstEvent](const char* name, const char* phase, const TraceBuffer::Event& event, const double start, const double duration)
+			{
+				json << (isFirstEvent ? "" : ",") << "{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"ts\":" << start;
+				if (phase[0] == 'X')
+				{
+					json << ",\"dur\":" << duration;
+				}
+				else
+				{
+					json << ",\"s\":\"t\"";
+				}
+				json << ",\"pid\":1,\"tid\":" << event.threadNumber << ",\"args\":{\"object\":\"0x" << std::hex << event.object << std::dec
+					<< "\",\"value\":" << event.value << "}}";
+				isFirstEvent = false;
+			};
+
+		// an open span is closed by the next matching event of the same thread and object
+		std::vector<TraceBuffer::Event> openSpans;
+		auto closeSpan = [&openSpans, &writeEvent, &toMicroseconds](const TraceEventType openingType, const char* name, const TraceBuffer::Event& closingEvent)
+			{
+				for (auto span = openSpans.rbegin(); span != openSpans.rend(); ++span)
+				{
+					if (span->type == openingType && span->object == closingEvent.object && span->threadNumber == closingEvent.threadNumber)
+					{
+						// a span carries the value of its closing event, the outcome of what it timed
+						auto spanEvent = *span;
+						spanEvent.value = closingEvent.value;
+						const auto start = toMicroseconds(span->timestamp);
+						writeEvent(name, "X", spanEvent, start, toMicroseconds(closingEvent.timestamp) - start);
+						openSpans.erase(std::next(span).base());
+						return;
+					}
+				}
+			};
+
+		for (const auto& event : events)
+		{
+			switch (event.type)
+			{
+			case PUSH_EVENT:
+				writeEvent("Push", "i", event, toMicroseconds(event.timestamp), 0.0);
+				break;
+			case POP_EVENT:
+				writeEvent("Pop", "i", event, toMicroseconds(event.timestamp), 0.0);
+				break;
+			case LOCK_ACQUIRE_END_EVENT:
+				closeSpan(LOCK_ACQUIRE_START_EVENT, "lock wait", event);
+				openSpans.push_back(event);
+				break;
+			case LOCK_RELEASE_EVENT:
+				closeSpan(LOCK_ACQUIRE_END_EVENT, "lock held", event);
+				break;
+			case SHARED_LOCK_ACQUIRE_END_EVENT:
+				closeSpan(SHARED_LOCK_ACQUIRE_START_EVENT, "shared lock wait", event);
+				openSpans.push_back(event);
+				break;
+			case SHARED_LOCK_RELEASE_EVENT:
+				closeSpan(SHARED_LOCK_ACQUIRE_END_EVENT, "shared lock held", event);
+				break;
+			case WAKE_EVENT:
+				closeSpan(WAIT_EVENT, "wait for items", event);
+				break;
+			case ELIMINATION_END_EVENT:
+				closeSpan(ELIMINATION_START_EVENT, "elimination", event);
+				break;
+			default:
+				openSpans.push_back(event);
+				break;
+			}
+		}
+		json << "]}";
+		return json.str();
+	}
+
+	inline void Tracer::WriteChromeTrace(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		file << ExportChromeTrace();
+		if (!file)
+		{
+			throw ThreadSafeStructs::ThreadSafetyException("Trace can not be written to " + path + ".");
+		}
+	}
+
+	inline Tracer::ThreadBufferOwner::ThreadBufferOwner() noexcept
+		: buffer(nullptr)
+	{
+	}
+
+	inline Tracer::ThreadBufferOwner::~ThreadBufferOwner()
+	{
+		if (buffer)
+		{
+			threadBuffer = nullptr;
+			isThreadBufferReleased = true;
+			buffer->Release();
+		}
+	}
+
+	template<typename LockPolicy>
+	TracedLock<LockPolicy>::TracedLock() noexcept
+	{
+	}
+
+	template<typename LockPolicy>
+	void TracedLock<LockPolicy>::lock()
+	{
+		Tracer::Record(LOCK_ACQUIRE_START_EVENT, this);
+		lockPolicy.lock();
+		Tracer::Record(LOCK_ACQUIRE_END_EVENT, this);
+	}
+
+	template<typename LockPolicy>
+	bool TracedLock<LockPolicy>::try_lock()
+	{
+		if (!lockPolicy.try_lock())
+		{
+			return false;
+		}
+		Tracer::Record(LOCK_ACQUIRE_END_EVENT, this);
+		return true;
+	}
+
+	template<typename LockPolicy>
+	void TracedLock<LockPolicy>::LockAfterFailedTry(const std::chrono::steady_clock::time_point failedTryAt) requires HasLockStatistics<LockPolicy>::value
+	{
+		Tracer::Record(LOCK_ACQUIRE_START_EVENT, this);
+		lockPolicy.LockAfterFailedTry(failedTryAt);
+		Tracer::Record(LOCK_ACQUIRE_END_EVENT, this);
+	}
+
+	template<typename LockPolicy>
+	void TracedLock<LockPolicy>::unlock()
+	{
+		Tracer::Record(LOCK_RELEASE_EVENT, this);
+		lockPolicy.unlock();
+	}
+
+	template<typename LockPolicy>
+	void TracedLock<LockPolicy>::lock_shared() requires IsSharedLockable<LockPolicy>::value
+	{
+		Tracer::Record(SHARED_LOCK_ACQUIRE_START_EVENT, this);
+		lockPolicy.lock_shared();
+		Tracer::Record(SHARED_LOCK_ACQUIRE_END_EVENT, this);
+	}
+
+	template<typename LockPolicy>
+	bool TracedLock<LockPolicy>::try_lock_shared() requires IsSharedLockable<LockPolicy>::value
+	{
+		if (!lockPolicy.try_lock_shared())
+		{
+			return false;
+		}
+		Tracer::Record(SHARED_LOCK_ACQUIRE_END_EVENT, this);
+		return true;
+	}
+
+	template<typename LockPolicy>
+	void TracedLock<LockPolicy>::unlock_shared() requires IsSharedLockable<LockPolicy>::value
+	{
+		Tracer::Record(SHARED_LOCK_RELEASE_EVENT, this);
+		lockPolicy.unlock_shared();
+	}
+
+	template<typename LockPolicy>
+	StackStatistics& TracedLock<LockPolicy>::Statistics() noexcept requires HasLockStatistics<LockPolicy>::value
+	{
+		return lockPolicy.Statistics();
+	}
+
+	template<typename LockPolicy>
+	const StackStatistics& TracedLock<LockPolicy>::Statistics() const noexcept requires HasLockStatistics<LockPolicy>::value
+	{
+		return lockPolicy.Statistics();
+	}
+}
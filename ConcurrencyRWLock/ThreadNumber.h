@@ -0,0 +1,13 @@
+#pragma once
+
+namespace ThreadSafeStructs
+{
+	// Consecutive number given to a thread on its first call, spreads threads evenly over
+	// per-thread slots and shards when taken modulo their count.
+	inline uint32_t GetCurrentThreadNumber() noexcept
+	{
+		static std::atomic<uint32_t> registeredThreadsCount(0);
+		thread_local static const uint32_t threadNumber = registeredThreadsCount.fetch_add(1, std::memory_order_relaxed);
+		return threadNumber;
+	}
+}
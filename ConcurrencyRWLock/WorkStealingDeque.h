@@ -0,0 +1,200 @@
+#pragma once
+#include "CacheLine.h"
+
+namespace ThreadSafeStructs
+{
+	// Chase-Lev work-stealing deque (memory orders follow Le, Pop, Cohen, Zappa Nardelli 2013).
+	// Only the owner thread may call Push/Pop, they work on the bottom end in LIFO order and need
+	// a CAS only when racing stealers for the last item. Any thread may Steal the oldest item from
+	// the top end. Items are copied through atomics, so T must be trivially copyable: keep task
+	// pointers or handles in the deque rather than the tasks themselves.
+	template<typename T>
+	class WorkStealingDeque
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque items must be trivially copyable.");
+
+	public:
+		explicit WorkStealingDeque(const int64_t initialCapacity = 64);
+		~WorkStealingDeque();
+		WorkStealingDeque(const WorkStealingDeque<T>& deque) = delete;
+		WorkStealingDeque<T>& operator=(const WorkStealingDeque<T>& deque) = delete;
+
+		// Owner thread only.
+		void Push(const T& item);
+		bool Pop(T& item);
+
+		// Any thread, returns false when the deque is empty or another thread won the race.
+		bool Steal(T& item);
+
+		bool Empty() const noexcept;
+		// Approximate while other threads steal.
+		uint32_t Size() const noexcept;
+
+	private:
+		class CircularArray
+		{
+		public:
+			explicit CircularArray(const int64_t capacity);
+
+			int64_t Capacity() const noexcept;
+			T Get(const int64_t index) const noexcept;
+			void Put(const int64_t index, const T& item) noexcept;
+			CircularArray* Grow(const int64_t top, const int64_t bottom) const;
+
+		private:
+			const int64_t capacity;
+			const int64_t mask;
+			std::unique_ptr<std::atomic<T>[]> items;
+		};
+
+		// thieves hammer top and the owner bottom, on one line every steal would stall the owner
+		alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top;
+		alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom;
+		std::atomic<CircularArray*> array;
+		// stealers may still read a replaced array, so they are kept until the deque dies
+		std::vector<std::unique_ptr<CircularArray>> retiredArrays;
+	};
+
+	template<typename T>
+	WorkStealingDeque<T>::CircularArray::CircularArray(const int64_t capacity)
+		: capacity(capacity),
+		mask(capacity - 1),
+		items(new std::atomic<T>[static_cast<size_t>(capacity)])
+	{
+	}
+
+	template<typename T>
+	int64_t WorkStealingDeque<T>::CircularArray::Capacity() const noexcept
+	{
+		return capacity;
+	}
+
+	template<typename T>
+	T WorkStealingDeque<T>::CircularArray::Get(const int64_t index) const noexcept
+	{
+		return items[index & mask].load(std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	void WorkStealingDeque<T>::CircularArray::Put(const int64_t index, const T& item) noexcept
+	{
+		items[index & mask].store(item, std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	typename WorkStealingDeque<T>::CircularArray* WorkStealingDeque<T>::CircularArray::Grow(const int64_t top, const int64_t bottom) const
+	{
+		auto grownArray = new CircularArray(capacity * 2);
+		for (auto index = top; index < bottom; ++index)
+		{
+			grownArray->Put(index, Get(index));
+		}
+		return grownArray;
+	}
+
+	template<typename T>
+	WorkStealingDeque<T>::WorkStealingDeque(const int64_t initialCapacity)
+		: top(0),
+		bottom(0),
+		array(nullptr)
+	{
+		// capacity has to be a power of two, indexes are wrapped with a mask
+		int64_t capacity = 1;
+		while (capacity < initialCapacity)
+		{
+			capacity *= 2;
+		}
+		array.store(new CircularArray(capacity), std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	WorkStealingDeque<T>::~WorkStealingDeque()
+	{
+		delete array.load(std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	void WorkStealingDeque<T>::Push(const T& item)
+	{
+		const auto currentBottom = bottom.load(std::memory_order_relaxed);
+		const auto currentTop = top.load(std::memory_order_acquire);
+		auto currentArray = array.load(std::memory_order_relaxed);
+
+		if (currentBottom - currentTop > currentArray->Capacity() - 1)
+		{
+			auto grownArray = currentArray->Grow(currentTop, currentBottom);
+			retiredArrays.emplace_back(currentArray);
+			array.store(grownArray, std::memory_order_release);
+			currentArray = grownArray;
+		}
+		currentArray->Put(currentBottom, item);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(currentBottom + 1, std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	bool WorkStealingDeque<T>::Pop(T& item)
+	{
+		const auto currentBottom = bottom.load(std::memory_order_relaxed) - 1;
+		auto currentArray = array.load(std::memory_order_relaxed);
+		bottom.store(currentBottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto currentTop = top.load(std::memory_order_relaxed);
+
+		if (currentTop > currentBottom)
+		{
+			bottom.store(currentBottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		auto poppedItem = currentArray->Get(currentBottom);
+		if (currentTop == currentBottom)
+		{
+			// last item, race stealers for it
+			const auto won = top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(currentBottom + 1, std::memory_order_relaxed);
+			if (!won)
+			{
+				return false;
+			}
+		}
+		item = poppedItem;
+		return true;
+	}
+
+	template<typename T>
+	bool WorkStealingDeque<T>::Steal(T& item)
+	{
+		auto currentTop = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const auto currentBottom = bottom.load(std::memory_order_acquire);
+
+		if (currentTop >= currentBottom)
+		{
+			return false;
+		}
+
+		auto currentArray = array.load(std::memory_order_acquire);
+		auto stolenItem = currentArray->Get(currentTop);
+		if (!top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return false;
+		}
+		item = stolenItem;
+		return true;
+	}
+
+	template<typename T>
+	bool WorkStealingDeque<T>::Empty() const noexcept
+	{
+		return Size() == 0;
+	}
+
+	template<typename T>
+	uint32_t WorkStealingDeque<T>::Size() const noexcept
+	{
+		const auto currentBottom = bottom.load(std::memory_order_relaxed);
+		const auto currentTop = top.load(std::memory_order_relaxed);
+		return currentBottom > currentTop ? static_cast<uint32_t>(currentBottom - currentTop) : 0;
+	}
+}
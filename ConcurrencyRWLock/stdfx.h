@@ -3,5 +3,25 @@
 #include <vector>
 #include <stdexcept>
 #include <condition_variable>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <limits>
+#include <chrono>
+#include <memory>
+#include <type_traits>
+#include <optional>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <coroutine>
+#include <concepts>
 
-#include "boost/thread/shared_mutex.hpp"
\ No newline at end of file
+#ifndef THREAD_SAFE_STRUCTS_NO_BOOST
+#include "boost/thread/shared_mutex.hpp"
+#endif
\ No newline at end of file
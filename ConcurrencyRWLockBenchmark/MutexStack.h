@@ -0,0 +1,96 @@
+#pragma once
+
+namespace ThreadSafeStructsBenchmark
+{
+	// Baseline every stack is compared against: std::stack behind one std::mutex, with the subset of
+	// the RWLockStack interface the benchmarks call.
+	template<typename T>
+	class MutexStack
+	{
+	public:
+		MutexStack<T>& Push(const T& item);
+		MutexStack<T>& PushRange(std::stack<T>&& stack);
+		bool TryPop(T& item);
+		T WhaitAndPop();
+		std::optional<T> Peek() const;
+		uint32_t Size() const;
+
+	private:
+		mutable std::mutex mutex;
+		std::condition_variable condVar;
+		std::stack<T> data;
+	};
+
+	template<typename T>
+	MutexStack<T>& MutexStack<T>::Push(const T& item)
+	{
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			data.push(item);
+		}
+		condVar.notify_one();
+		return *this;
+	}
+
+	template<typename T>
+	MutexStack<T>& MutexStack<T>::PushRange(std::stack<T>&& stack)
+	{
+		// std::stack has no splice, items go over one by one in their original order
+		std::vector<T> items;
+		items.reserve(stack.size());
+		for (; !stack.empty(); stack.pop())
+		{
+			items.push_back(std::move(stack.top()));
+		}
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			for (auto item = items.rbegin(); item != items.rend(); ++item)
+			{
+				data.push(std::move(*item));
+			}
+		}
+		condVar.notify_all();
+		return *this;
+	}
+
+	template<typename T>
+	bool MutexStack<T>::TryPop(T& item)
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (data.empty())
+		{
+			return false;
+		}
+		item = std::move(data.top());
+		data.pop();
+		return true;
+	}
+
+	template<typename T>
+	T MutexStack<T>::WhaitAndPop()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condVar.wait(lock, [this]() { return !data.empty(); });
+		auto item = std::move(data.top());
+		data.pop();
+		return item;
+	}
+
+	template<typename T>
+	std::optional<T> MutexStack<T>::Peek() const
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (data.empty())
+		{
+			return std::nullopt;
+		}
+		return data.top();
+	}
+
+	template<typename T>
+	uint32_t MutexStack<T>::Size() const
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<uint32_t>(data.size());
+	}
+}
@@ -0,0 +1,435 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "FlatCombiningStack.h"
+#include "MutexStack.h"
+#include "LatencyHistogram.h"
+#include "TestWorkerPool.h"
+#include "StackTrace.h"
+
+namespace
+{
+	template<size_t Size>
+	struct Payload
+	{
+		char bytes[Size] = {};
+	};
+
+	// items a thread pushes or pops between two untimed clean ups, keeps the stack size bounded
+	const int64_t BATCH_SIZE = 256;
+	const int64_t RANGE_SIZE = 64;
+	const int MAX_THREADS = static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+
+	// Every instantiation gets its own stack, shared by all threads of a run.
+	template<typename Stack>
+	Stack& GetSharedStack()
+	{
+		static Stack stack;
+		return stack;
+	}
+
+	template<typename Stack, typename Item>
+	void PopBatch(Stack& stack, const int64_t itemsCount)
+	{
+		Item item;
+		for (int64_t popped = 0; popped < itemsCount && stack.TryPop(item); ++popped)
+		{
+		}
+	}
+
+	template<typename Stack, typename Item>
+	void PushBatch(Stack& stack, const int64_t itemsCount)
+	{
+		const Item item{};
+		for (int64_t pushed = 0; pushed < itemsCount; ++pushed)
+		{
+			stack.Push(item);
+		}
+	}
+
+	template<typename Stack, typename Item>
+	void PushBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		const Item item{};
+		int64_t pushed = 0;
+		for (auto _ : state)
+		{
+			stack.Push(item);
+			if (++pushed % BATCH_SIZE == 0)
+			{
+				state.PauseTiming();
+				PopBatch<Stack, Item>(stack, BATCH_SIZE);
+				state.ResumeTiming();
+			}
+		}
+		PopBatch<Stack, Item>(stack, pushed % BATCH_SIZE);
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	template<typename Stack, typename Item>
+	void TryPopBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		Item item;
+		int64_t popped = 0;
+		for (auto _ : state)
+		{
+			if (popped++ % BATCH_SIZE == 0)
+			{
+				state.PauseTiming();
+				PushBatch<Stack, Item>(stack, BATCH_SIZE);
+				state.ResumeTiming();
+			}
+			benchmark::DoNotOptimize(stack.TryPop(item));
+		}
+		PopBatch<Stack, Item>(stack, std::numeric_limits<int64_t>::max());
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	template<typename Stack, typename Item>
+	void PushRangeBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		std::stack<Item> range;
+		for (int64_t pushed = 0; pushed < RANGE_SIZE; ++pushed)
+		{
+			range.push(Item());
+		}
+		int64_t pushedRanges = 0;
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			auto rangeCopy = range;
+			state.ResumeTiming();
+			stack.PushRange(std::move(rangeCopy));
+			if (++pushedRanges % (BATCH_SIZE / RANGE_SIZE) == 0)
+			{
+				state.PauseTiming();
+				PopBatch<Stack, Item>(stack, BATCH_SIZE);
+				state.ResumeTiming();
+			}
+		}
+		PopBatch<Stack, Item>(stack, (pushedRanges % (BATCH_SIZE / RANGE_SIZE)) * RANGE_SIZE);
+		state.SetItemsProcessed(state.iterations() * RANGE_SIZE);
+	}
+
+	template<typename Stack, typename Item>
+	void SizeBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		if (state.thread_index() == 0)
+		{
+			PushBatch<Stack, Item>(stack, 1);
+		}
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(stack.Size());
+		}
+		if (state.thread_index() == 0)
+		{
+			PopBatch<Stack, Item>(stack, std::numeric_limits<int64_t>::max());
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	// Even threads push, odd threads block in WhaitAndPop for what they push. All threads run the
+	// same number of iterations, so every pop gets its item.
+	template<typename Stack, typename Item>
+	void WaitAndPopHandoffBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		const Item item{};
+		const auto isProducer = state.thread_index() % 2 == 0;
+		for (auto _ : state)
+		{
+			if (isProducer)
+			{
+				stack.Push(item);
+			}
+			else
+			{
+				benchmark::DoNotOptimize(stack.WhaitAndPop());
+			}
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	// range(0) is the percentage of Peek calls, the rest alternates Push and TryPop.
+	template<typename Stack, typename Item>
+	void ReadWriteMixBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		const auto readPercentage = state.range(0);
+		const Item pushedItem{};
+		Item poppedItem;
+		int64_t operation = 0;
+		bool push = true;
+		for (auto _ : state)
+		{
+			if (operation++ % 100 < readPercentage)
+			{
+				benchmark::DoNotOptimize(stack.Peek());
+			}
+			else if (push)
+			{
+				stack.Push(pushedItem);
+				push = false;
+			}
+			else
+			{
+				benchmark::DoNotOptimize(stack.TryPop(poppedItem));
+				push = true;
+			}
+		}
+		PopBatch<Stack, Item>(stack, push ? 0 : 1);
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	// Push then TryPop on the stack all threads share, so every operation contends for the lock.
+	// A thread whose item was taken by another one pops nothing, at most a few items stay behind.
+	template<typename Stack, typename Item>
+	void PushPopBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		const Item pushedItem{};
+		Item poppedItem;
+		for (auto _ : state)
+		{
+			stack.Push(pushedItem);
+			benchmark::DoNotOptimize(stack.TryPop(poppedItem));
+		}
+		state.SetItemsProcessed(2 * state.iterations());
+	}
+
+	// Every thread fills its own stack and empties it again, the chunks go back to Allocator
+	// and come from it again, with all threads allocating at once.
+	template<typename Stack, typename Item>
+	void ChurnBenchmark(benchmark::State& state)
+	{
+		Stack stack;
+		const auto itemsCount = state.range(0);
+		for (auto _ : state)
+		{
+			PushBatch<Stack, Item>(stack, itemsCount);
+			PopBatch<Stack, Item>(stack, itemsCount);
+		}
+		state.SetItemsProcessed(2 * itemsCount * state.iterations());
+	}
+
+	// Every thread pushes and pops on its own stack of an array, the stacks never contend for
+	// a lock, so any slowdown with more threads is neighbours in the array sharing cache lines.
+	template<typename Stack, typename Item>
+	void OwnStackInArrayBenchmark(benchmark::State& state)
+	{
+		static std::vector<Stack> stacks(MAX_THREADS);
+		auto& stack = stacks[state.thread_index()];
+		const Item pushedItem{};
+		Item poppedItem;
+		for (auto _ : state)
+		{
+			stack.Push(pushedItem);
+			benchmark::DoNotOptimize(stack.TryPop(poppedItem));
+		}
+		state.SetItemsProcessed(2 * state.iterations());
+	}
+
+	// Latency percentiles of single operations, as the stress driver of the tests reports them.
+	// Even threads Push and odd threads TryPop, the counters are averaged over the threads.
+	template<typename Stack, typename Item>
+	void OperationLatencyBenchmark(benchmark::State& state)
+	{
+		auto& stack = GetSharedStack<Stack>();
+		const Item pushedItem{};
+		Item poppedItem;
+		const auto isProducer = state.thread_index() % 2 == 0;
+		LatencyHistogram latencies;
+		// one clock read per operation, its end is the start of the next one
+		auto operationStart = std::chrono::steady_clock::now();
+		for (auto _ : state)
+		{
+			if (isProducer)
+			{
+				stack.Push(pushedItem);
+			}
+			else
+			{
+				benchmark::DoNotOptimize(stack.TryPop(poppedItem));
+			}
+			const auto operationEnd = std::chrono::steady_clock::now();
+			latencies.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(operationEnd - operationStart).count()));
+			operationStart = operationEnd;
+		}
+		if (isProducer)
+		{
+			PopBatch<Stack, Item>(stack, state.iterations());
+		}
+		state.counters["p50_ns"] = benchmark::Counter(static_cast<double>(latencies.ValueAtPercentile(50.0)), benchmark::Counter::kAvgThreads);
+		state.counters["p99_ns"] = benchmark::Counter(static_cast<double>(latencies.ValueAtPercentile(99.0)), benchmark::Counter::kAvgThreads);
+		state.counters["p99.9_ns"] = benchmark::Counter(static_cast<double>(latencies.ValueAtPercentile(99.9)), benchmark::Counter::kAvgThreads);
+		state.counters["max_ns"] = benchmark::Counter(static_cast<double>(latencies.Max()), benchmark::Counter::kAvgThreads);
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	// A round of range(0) threads pushing one item each, the threads launched and joined every
+	// round here, released by the barriers of a TestWorkerPool below.
+	void ThreadLaunchRoundBenchmark(benchmark::State& state)
+	{
+		ThreadSafeStructs::RWLockStack<int> stack;
+		const auto threadsCount = state.range(0);
+		std::vector<std::thread> threads;
+		threads.reserve(static_cast<size_t>(threadsCount));
+		for (auto _ : state)
+		{
+			for (int64_t thread = 0; thread < threadsCount; ++thread)
+			{
+				threads.emplace_back([&stack]() { stack.Push(1); });
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			threads.clear();
+		}
+		state.SetItemsProcessed(state.iterations() * threadsCount);
+	}
+
+	void WorkerPoolRoundBenchmark(benchmark::State& state)
+	{
+		ThreadSafeStructs::RWLockStack<int> stack;
+		const auto threadsCount = state.range(0);
+		TestWorkerPool workerPool(static_cast<uint32_t>(threadsCount));
+		for (auto _ : state)
+		{
+			workerPool.RunRound([&stack](const uint32_t) { stack.Push(1); });
+		}
+		state.SetItemsProcessed(state.iterations() * threadsCount);
+	}
+
+	// Pop on an empty stack, TryPop() throws, TryPop(item) returns false.
+	template<typename Stack, typename Item>
+	void ThrowingTryPopOnEmptyBenchmark(benchmark::State& state)
+	{
+		Stack stack;
+		for (auto _ : state)
+		{
+			try
+			{
+				benchmark::DoNotOptimize(stack.TryPop());
+			}
+			catch (const ThreadSafeStructs::ThreadSafetyException&)
+			{
+			}
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	template<typename Stack, typename Item>
+	void TryPopOnEmptyBenchmark(benchmark::State& state)
+	{
+		Stack stack;
+		Item item;
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(stack.TryPop(item));
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	int64_t GetTimestampNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// The consumer sleeps in popFunction, every iteration pushes a timestamp after a short pause.
+	// The manual iteration time runs from that push to the pop returning on the consumer thread.
+	template<typename PopFunction>
+	void WakeUpLatencyBenchmark(benchmark::State& state, PopFunction popFunction)
+	{
+		ThreadSafeStructs::RWLockStack<int64_t> stack;
+		std::atomic<int64_t> latency(-1);
+		std::thread consumer([&stack, &latency, &popFunction]()
+			{
+				for (auto pushedAt = popFunction(stack); pushedAt >= 0; pushedAt = popFunction(stack))
+				{
+					latency.store(GetTimestampNanoseconds() - pushedAt, std::memory_order_release);
+				}
+			});
+
+		for (auto _ : state)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			latency.store(-1, std::memory_order_relaxed);
+			stack.Push(GetTimestampNanoseconds());
+			auto measuredLatency = latency.load(std::memory_order_acquire);
+			for (; measuredLatency < 0; measuredLatency = latency.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+			state.SetIterationTime(static_cast<double>(measuredLatency) / 1e9);
+		}
+		// a negative timestamp stops the consumer
+		stack.Push(-1);
+		consumer.join();
+	}
+
+	void TraceRecordBenchmark(benchmark::State& state)
+	{
+		uint32_t value = 0;
+		for (auto _ : state)
+		{
+			ThreadSafeStructs::Tracer::Record(ThreadSafeStructs::PUSH_EVENT, &state, ++value);
+		}
+		state.SetItemsProcessed(state.iterations());
+		ThreadSafeStructs::Tracer::Instance().Clear();
+	}
+}
+
+#define REGISTER_STACK_BENCHMARKS(Item) \
+	BENCHMARK_TEMPLATE(PushBenchmark, ThreadSafeStructs::RWLockStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(PushBenchmark, ThreadSafeStructsBenchmark::MutexStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(TryPopBenchmark, ThreadSafeStructs::RWLockStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(TryPopBenchmark, ThreadSafeStructsBenchmark::MutexStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(PushRangeBenchmark, ThreadSafeStructs::RWLockStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(PushRangeBenchmark, ThreadSafeStructsBenchmark::MutexStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(SizeBenchmark, ThreadSafeStructs::RWLockStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(SizeBenchmark, ThreadSafeStructsBenchmark::MutexStack<Item>, Item)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(WaitAndPopHandoffBenchmark, ThreadSafeStructs::RWLockStack<Item>, Item)->ThreadRange(2, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(WaitAndPopHandoffBenchmark, ThreadSafeStructsBenchmark::MutexStack<Item>, Item)->ThreadRange(2, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(ReadWriteMixBenchmark, ThreadSafeStructs::RWLockStack<Item>, Item)->Arg(0)->Arg(50)->Arg(90)->Arg(99)->ThreadRange(1, MAX_THREADS)->UseRealTime(); \
+	BENCHMARK_TEMPLATE(ReadWriteMixBenchmark, ThreadSafeStructsBenchmark::MutexStack<Item>, Item)->Arg(0)->Arg(50)->Arg(90)->Arg(99)->ThreadRange(1, MAX_THREADS)->UseRealTime()
+
+REGISTER_STACK_BENCHMARKS(int);
+REGISTER_STACK_BENCHMARKS(Payload<64>);
+REGISTER_STACK_BENCHMARKS(Payload<1024>);
+
+BENCHMARK_TEMPLATE(ThrowingTryPopOnEmptyBenchmark, ThreadSafeStructs::RWLockStack<int>, int);
+BENCHMARK_TEMPLATE(TryPopOnEmptyBenchmark, ThreadSafeStructs::RWLockStack<int>, int);
+BENCHMARK_CAPTURE(WakeUpLatencyBenchmark, ConditionVariable, [](ThreadSafeStructs::RWLockStack<int64_t>& stack) { return stack.WhaitAndPop(); })->UseManualTime();
+BENCHMARK_CAPTURE(WakeUpLatencyBenchmark, AtomicWait, [](ThreadSafeStructs::RWLockStack<int64_t>& stack) { return stack.AtomicWaitAndPop(); })->UseManualTime();
+
+#define REGISTER_LOCK_POLICY_BENCHMARK(LockPolicy) \
+	BENCHMARK_TEMPLATE(PushPopBenchmark, ThreadSafeStructs::RWLockStack<int, LockPolicy>, int)->ThreadRange(1, MAX_THREADS)->UseRealTime()
+
+REGISTER_LOCK_POLICY_BENCHMARK(ThreadSafeStructs::DefaultLockPolicy);
+REGISTER_LOCK_POLICY_BENCHMARK(std::shared_mutex);
+REGISTER_LOCK_POLICY_BENCHMARK(std::mutex);
+REGISTER_LOCK_POLICY_BENCHMARK(ThreadSafeStructs::TTASSpinLock);
+REGISTER_LOCK_POLICY_BENCHMARK(ThreadSafeStructs::TicketLock);
+REGISTER_LOCK_POLICY_BENCHMARK(ThreadSafeStructs::McsLock);
+
+BENCHMARK_TEMPLATE(ChurnBenchmark, ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::DefaultLockPolicy, std::allocator<int>>, int)->Arg(5000)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(ChurnBenchmark, ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::DefaultLockPolicy, ThreadSafeStructs::PoolAllocator<int>>, int)->Arg(5000)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(PushPopBenchmark, ThreadSafeStructs::FlatCombiningStack<int>, int)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+
+// RWLockStack is cache line aligned, MutexStack shows the same stack packed and padded.
+BENCHMARK_TEMPLATE(OwnStackInArrayBenchmark, ThreadSafeStructs::RWLockStack<int>, int)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(OwnStackInArrayBenchmark, ThreadSafeStructsBenchmark::MutexStack<int>, int)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(OwnStackInArrayBenchmark, ThreadSafeStructs::CacheLinePadded<ThreadSafeStructsBenchmark::MutexStack<int>>, int)->ThreadRange(1, MAX_THREADS)->UseRealTime();
+
+BENCHMARK_TEMPLATE(OperationLatencyBenchmark, ThreadSafeStructs::RWLockStack<int>, int)->ThreadRange(2, MAX_THREADS)->UseRealTime();
+BENCHMARK_TEMPLATE(OperationLatencyBenchmark, ThreadSafeStructsBenchmark::MutexStack<int>, int)->ThreadRange(2, MAX_THREADS)->UseRealTime();
+
+BENCHMARK(ThreadLaunchRoundBenchmark)->Arg(4)->UseRealTime();
+BENCHMARK(WorkerPoolRoundBenchmark)->Arg(4)->UseRealTime();
+
+BENCHMARK(TraceRecordBenchmark)->ThreadRange(1, MAX_THREADS)->UseRealTime();
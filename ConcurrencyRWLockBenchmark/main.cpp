@@ -0,0 +1,39 @@
+#include "stdfx.h"
+
+namespace
+{
+	bool HasArgument(const int argc, char** argv, const char* prefix)
+	{
+		return std::any_of(argv + 1, argv + argc, [prefix](const char* argument)
+			{
+				return std::strncmp(argument, prefix, std::strlen(prefix)) == 0;
+			});
+	}
+}
+
+// Console output as usual, plus a JSON report for comparing releases. The report goes to
+// stack_benchmarks.json unless --benchmark_out is given.
+int main(int argc, char** argv)
+{
+	std::vector<char*> arguments(argv, argv + argc);
+	std::string outArgument = "--benchmark_out=stack_benchmarks.json";
+	std::string outFormatArgument = "--benchmark_out_format=json";
+	if (!HasArgument(argc, argv, "--benchmark_out="))
+	{
+		arguments.push_back(outArgument.data());
+	}
+	if (!HasArgument(argc, argv, "--benchmark_out_format="))
+	{
+		arguments.push_back(outFormatArgument.data());
+	}
+
+	auto argumentsCount = static_cast<int>(arguments.size());
+	benchmark::Initialize(&argumentsCount, arguments.data());
+	if (benchmark::ReportUnrecognizedArguments(argumentsCount, arguments.data()))
+	{
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "benchmark/benchmark.h"
+#include <string>
+#include <cstring>
+
+#include <stack>
+#include <vector>
+#include <stdexcept>
+#include <condition_variable>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <limits>
+#include <chrono>
+#include <memory>
+#include <type_traits>
+#include <optional>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <coroutine>
+#include <concepts>
+#include <bit>
+#include <cmath>
+#include <barrier>
+#ifndef THREAD_SAFE_STRUCTS_NO_BOOST
+#include "boost/thread/shared_mutex.hpp"
+#endif
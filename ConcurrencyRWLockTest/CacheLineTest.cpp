@@ -0,0 +1,24 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "CacheLine.h"
+
+namespace
+{
+	struct LockedCounter
+	{
+		ThreadSafeStructs::TTASSpinLock lock;
+		int64_t value = 0;
+	};
+}
+
+TEST(CacheLine, StacksInArrayDoNotShareCacheLines)
+{
+	static_assert(alignof(ThreadSafeStructs::RWLockStack<int>) == ThreadSafeStructs::CACHE_LINE_SIZE, "RWLockStack is not cache line aligned");
+	static_assert(sizeof(ThreadSafeStructs::CacheLinePadded<LockedCounter>) == ThreadSafeStructs::CACHE_LINE_SIZE, "Padded counter does not fill one cache line");
+
+	std::vector<ThreadSafeStructs::RWLockStack<int>> containers(2);
+	const auto first = reinterpret_cast<uintptr_t>(&containers[0]);
+	const auto second = reinterpret_cast<uintptr_t>(&containers[1]);
+	EXPECT_EQ(first % ThreadSafeStructs::CACHE_LINE_SIZE, 0);
+	EXPECT_EQ(second % ThreadSafeStructs::CACHE_LINE_SIZE, 0);
+}
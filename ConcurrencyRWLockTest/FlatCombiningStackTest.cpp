@@ -0,0 +1,80 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "FlatCombiningStack.h"
+#include "ThreadSafeException.h"
+#include "RWLStackTestUtils.h"
+#include "SeparatedThreadCallbackExecutor.h"
+
+TEST(FlatCombiningStack, CreateContainer_Empty)
+{
+	ThreadSafeStructs::FlatCombiningStack<int> container(4);
+
+	EXPECT_TRUE(container.Empty());
+	EXPECT_EQ(container.Size(), 0);
+	EXPECT_THROW(container.TryPop(), ThreadSafeStructs::ThreadSafetyException);
+}
+
+TEST(FlatCombiningStack, PushPopItemsKeepLIFOOrderInOneThread)
+{
+	ThreadSafeStructs::FlatCombiningStack<std::string> container(4);
+
+	for (int number = 0; number < 100; ++number)
+	{
+		container.Push(std::to_string(number));
+	}
+	ASSERT_EQ(container.Size(), 100);
+
+	for (int number = 99; number >= 0; --number)
+	{
+		ASSERT_EQ(container.TryPop(), std::to_string(number));
+	}
+	std::string item;
+	EXPECT_FALSE(container.TryPop(item));
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(FlatCombiningStack, PushAndPopWithMoreThreadsThanSlots)
+{
+	ThreadSafeStructs::FlatCombiningStack<int> container(2);
+	std::atomic<int64_t> pushedSum(0);
+	std::atomic<int64_t> popedSum(0);
+	const auto numberOfGeneratedNumbers = 10000;
+	const auto numberOfTestingThreads = 8;
+
+	auto pushAndPopFunction = [numberOfGeneratedNumbers, &container, &pushedSum, &popedSum]()
+		{
+			for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers; ++numbersGenerated)
+			{
+				container.Push(numbersGenerated);
+				pushedSum += numbersGenerated;
+				int item;
+				if (container.TryPop(item))
+				{
+					popedSum += item;
+				}
+			}
+		};
+
+	TestThreadsManager<decltype(pushAndPopFunction), int> threadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(pushAndPopFunction), int>>(
+				pushAndPopFunction,
+				threadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	threadsManger.WaitThreadFinished();
+
+	ASSERT_EQ(threadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
+	ASSERT_EQ(threadsManger.GetThreadsProcessedExceptionsCount(), 0);
+
+	int item;
+	while (container.TryPop(item))
+	{
+		popedSum += item;
+	}
+	EXPECT_EQ(pushedSum.load(), popedSum.load());
+	EXPECT_TRUE(container.Empty());
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// HDR style histogram of nanosecond latencies. Values below SUB_BUCKETS_COUNT are counted exactly,
+// every power of two above is split into SUB_BUCKETS_COUNT / 2 linear buckets, so a percentile
+// is off by less than 1/64 of its value whatever the range, with a fixed 30KB of counters.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void Record(const uint64_t value) noexcept;
+	void Merge(const LatencyHistogram& histogram) noexcept;
+
+	uint64_t Count() const noexcept;
+	uint64_t Max() const noexcept;
+	// Upper bound of the bucket holding the percentile, never above Max(). Zero when empty.
+	uint64_t ValueAtPercentile(const double percentile) const noexcept;
+
+private:
+	static const uint32_t SUB_BUCKET_BITS = 7;
+	static const uint64_t SUB_BUCKETS_COUNT = 1ull << SUB_BUCKET_BITS;
+	static const uint64_t HALF_SUB_BUCKETS_COUNT = SUB_BUCKETS_COUNT / 2;
+
+	static size_t GetBucketIndex(const uint64_t value) noexcept;
+	static uint64_t GetBucketUpperBound(const size_t index) noexcept;
+
+	std::vector<uint64_t> counts;
+	uint64_t count;
+	uint64_t max;
+};
+
+inline LatencyHistogram::LatencyHistogram()
+	: counts(SUB_BUCKETS_COUNT + (64 - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS_COUNT, 0),
+	count(0),
+	max(0)
+{
+}
+
+inline void LatencyHistogram::Record(const uint64_t value) noexcept
+{
+	++counts[GetBucketIndex(value)];
+	++count;
+	max = std::max(max, value);
+}
+
+inline void LatencyHistogram::Merge(const LatencyHistogram& histogram) noexcept
+{
+	for (size_t index = 0; index < counts.size(); ++index)
+	{
+		counts[index] += histogram.counts[index];
+	}
+	count += histogram.count;
+	max = std::max(max, histogram.max);
+}
+
+inline uint64_t LatencyHistogram::Count() const noexcept
+{
+	return count;
+}
+
+inline uint64_t LatencyHistogram::Max() const noexcept
+{
+	return max;
+}
+
+inline uint64_t LatencyHistogram::ValueAtPercentile(const double percentile) const noexcept
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+	const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(count))));
+	uint64_t countBelow = 0;
+	for (size_t index = 0; index < counts.size(); ++index)
+	{
+		countBelow += counts[index];
+		if (countBelow >= rank)
+		{
+			return std::min(GetBucketUpperBound(index), max);
+		}
+	}
+	return max;
+}
+
+inline size_t LatencyHistogram::GetBucketIndex(const uint64_t value) noexcept
+{
+	if (value < SUB_BUCKETS_COUNT)
+	{
+		return static_cast<size_t>(value);
+	}
+	// bucket width of the power of two holding value
+	const auto shift = static_cast<uint32_t>(std::bit_width(value)) - SUB_BUCKET_BITS;
+	return static_cast<size_t>(SUB_BUCKETS_COUNT + (shift - 1) * HALF_SUB_BUCKETS_COUNT + (value >> shift) - HALF_SUB_BUCKETS_COUNT);
+}
+
+inline uint64_t LatencyHistogram::GetBucketUpperBound(const size_t index) noexcept
+{
+	if (index < SUB_BUCKETS_COUNT)
+	{
+		return index;
+	}
+	const auto shift = static_cast<uint32_t>((index - SUB_BUCKETS_COUNT) / HALF_SUB_BUCKETS_COUNT + 1);
+	const auto subBucket = (index - SUB_BUCKETS_COUNT) % HALF_SUB_BUCKETS_COUNT + HALF_SUB_BUCKETS_COUNT;
+	return ((subBucket + 1) << shift) - 1;
+}
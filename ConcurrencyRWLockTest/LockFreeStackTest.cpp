@@ -0,0 +1,92 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "LockFreeStack.h"
+#include "ThreadSafeException.h"
+#include "RWLStackTestUtils.h"
+#include "SeparatedThreadCallbackExecutor.h"
+
+TEST(LockFreeStack, CreateContainer_Empty)
+{
+	ThreadSafeStructs::LockFreeStack<int> container;
+
+	EXPECT_TRUE(container.Empty());
+	EXPECT_EQ(container.Size(), 0);
+}
+
+TEST(LockFreeStack, PopItemFromEmptyContainer_OneThread)
+{
+	ThreadSafeStructs::LockFreeStack<int> container;
+	EXPECT_THROW(container.TryPop(), ThreadSafeStructs::ThreadSafetyException);
+}
+
+TEST(LockFreeStack, TryPopWithoutExceptionFromEmptyContainer_OneThread)
+{
+	ThreadSafeStructs::LockFreeStack<int> container;
+	int item = -1;
+
+	EXPECT_FALSE(container.TryPop(item));
+	EXPECT_EQ(item, -1);
+
+	container.Push(5);
+	EXPECT_TRUE(container.TryPop(item));
+	EXPECT_EQ(item, 5);
+}
+
+TEST(LockFreeStack, PushPopItemsKeepLIFOOrder_OneThread)
+{
+	ThreadSafeStructs::LockFreeStack<int> container;
+	std::stack<int> orignContainer;
+
+	for (int number = 0; number < 100; ++number)
+	{
+		container.Push(number);
+		orignContainer.push(number);
+	}
+	ASSERT_EQ(orignContainer.size(), container.Size());
+
+	while (!orignContainer.empty())
+	{
+		ASSERT_EQ(orignContainer.top(), container.TryPop());
+		orignContainer.pop();
+	}
+	EXPECT_TRUE(container.Empty());
+	EXPECT_THROW(container.TryPop(), ThreadSafeStructs::ThreadSafetyException);
+}
+
+TEST(LockFreeStack, PushAndPopWithMultipleThreads)
+{
+	ThreadSafeStructs::LockFreeStack<int> container;
+	std::atomic<int64_t> pushedSum(0);
+	std::atomic<int64_t> popedSum(0);
+	const auto numberOfGeneratedNumbers = 10000;
+	const auto numberOfTestingThreads = 8;
+
+	auto pushAndPopFunction = [numberOfGeneratedNumbers, &container, &pushedSum, &popedSum]()
+		{
+			for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers; ++numbersGenerated)
+			{
+				container.Push(numbersGenerated);
+				pushedSum += numbersGenerated;
+				popedSum += container.TryPop();
+			}
+		};
+
+	TestThreadsManager<decltype(pushAndPopFunction), int> threadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(pushAndPopFunction), int>>(
+				pushAndPopFunction,
+				threadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	threadsManger.WaitThreadFinished();
+
+	ASSERT_EQ(threadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
+	ASSERT_EQ(threadsManger.GetThreadsProcessedExceptionsCount(), 0);
+
+	EXPECT_EQ(pushedSum.load(), popedSum.load());
+	EXPECT_TRUE(container.Empty());
+	EXPECT_EQ(container.Size(), 0);
+}
@@ -0,0 +1,124 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "LockPolicies.h"
+
+namespace
+{
+	template<typename LockPolicy>
+	class LockPolicies : public ::testing::Test
+	{
+	};
+
+	using ThreadSafeLockPolicies = ::testing::Types<
+		ThreadSafeStructs::DefaultLockPolicy,
+		std::shared_mutex,
+		std::mutex,
+		ThreadSafeStructs::TTASSpinLock,
+		ThreadSafeStructs::TicketLock,
+		ThreadSafeStructs::McsLock>;
+	TYPED_TEST_SUITE(LockPolicies, ThreadSafeLockPolicies);
+}
+
+TYPED_TEST(LockPolicies, TryLockFailsWhileLocked_OneThread)
+{
+	TypeParam lock;
+
+	lock.lock();
+	auto tryLockDone = std::async(std::launch::async, [&lock]()
+		{
+			return lock.try_lock();
+		});
+	EXPECT_FALSE(tryLockDone.get());
+	lock.unlock();
+
+	EXPECT_TRUE(lock.try_lock());
+	lock.unlock();
+}
+
+TYPED_TEST(LockPolicies, LockGivesMutualExclusionToMultipleThreads)
+{
+	TypeParam lock;
+	int64_t counter = 0;
+	const auto numberOfIncrements = 10000;
+	const auto numberOfTestingThreads = 8;
+
+	std::list<std::future<void>> threadsDone;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsDone.push_back(std::async(std::launch::async, [numberOfIncrements, &lock, &counter]()
+			{
+				for (int increment = 0; increment < numberOfIncrements; ++increment)
+				{
+					const std::lock_guard<TypeParam> guard(lock);
+					++counter;
+				}
+			}));
+	}
+	for (auto& threadDone : threadsDone)
+	{
+		threadDone.get();
+	}
+
+	EXPECT_EQ(counter, numberOfIncrements * numberOfTestingThreads);
+}
+
+TYPED_TEST(LockPolicies, RWLockStackPushAndPopWithMultipleThreads)
+{
+	ThreadSafeStructs::RWLockStack<int, TypeParam> container;
+	std::atomic<int64_t> pushedSum(0);
+	std::atomic<int64_t> popedSum(0);
+	const auto numberOfGeneratedNumbers = 10000;
+	const auto numberOfTestingThreads = 4;
+
+	std::list<std::future<void>> threadsDone;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsDone.push_back(std::async(std::launch::async, [numberOfGeneratedNumbers, &container, &pushedSum, &popedSum]()
+			{
+				int item;
+				for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers; ++numbersGenerated)
+				{
+					container.Push(numbersGenerated);
+					pushedSum += numbersGenerated;
+					if (container.TryPop(item))
+					{
+						popedSum += item;
+					}
+				}
+			}));
+	}
+	for (auto& threadDone : threadsDone)
+	{
+		threadDone.get();
+	}
+
+	int item;
+	while (container.TryPop(item))
+	{
+		popedSum += item;
+	}
+	EXPECT_EQ(pushedSum.load(), popedSum.load());
+	EXPECT_TRUE(container.Empty());
+
+	container.Push(1).Push(2);
+	ThreadSafeStructs::RWLockStack<int, TypeParam> copiedContainer(container);
+	EXPECT_EQ(copiedContainer.Size(), 2);
+}
+
+TEST(LockPolicies, NullLockStackKeepsLIFOOrder_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::NullLock> container;
+	for (int number = 0; number < 100; ++number)
+	{
+		container.Push(number);
+	}
+
+	ThreadSafeStructs::RWLockStack<int> sharedContainer;
+	sharedContainer.PushRange(container.ExportOrignContainer());
+	for (int number = 99; number >= 0; --number)
+	{
+		ASSERT_EQ(container.TryPop(), number);
+		ASSERT_EQ(sharedContainer.TryPop(), number);
+	}
+	EXPECT_TRUE(container.Empty());
+}
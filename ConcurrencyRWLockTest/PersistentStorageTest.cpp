@@ -0,0 +1,79 @@
+#include "stdfx.h"
+#include "PersistentStorage.h"
+
+TEST(PersistentStorage, PushPopKeepLIFOOrder)
+{
+	ThreadSafeStructs::PersistentStorage<int> storage;
+	for (int number = 0; number < 100; ++number)
+	{
+		storage.push_back(number);
+	}
+	ASSERT_EQ(storage.size(), 100);
+
+	for (int number = 99; number >= 0; --number)
+	{
+		ASSERT_EQ(storage.back(), number);
+		storage.pop_back();
+	}
+	EXPECT_TRUE(storage.empty());
+}
+
+TEST(PersistentStorage, SnapshotIsNotChangedByLaterPushesAndPops)
+{
+	ThreadSafeStructs::PersistentStorage<int> storage;
+	for (int number = 0; number < 10; ++number)
+	{
+		storage.push_back(number);
+	}
+
+	auto snapshot = storage.Snapshot();
+	storage.pop_back();
+	storage.pop_back();
+	storage.push_back(100);
+	storage.clear();
+
+	ASSERT_EQ(snapshot.size(), 10);
+	int expected = 9;
+	for (const auto& item : snapshot)
+	{
+		ASSERT_EQ(item, expected--);
+	}
+	EXPECT_EQ(expected, -1);
+}
+
+TEST(PersistentStorage, CopySharesItems)
+{
+	ThreadSafeStructs::PersistentStorage<std::string> storage;
+	storage.push_back("bottom");
+	storage.push_back("top");
+
+	auto copy = storage;
+	EXPECT_EQ(&copy.back(), &storage.back());
+
+	copy.pop_back();
+	copy.push_back("other top");
+	EXPECT_EQ(storage.back(), "top");
+	EXPECT_EQ(copy.back(), "other top");
+
+	std::vector<std::string> fromBottom;
+	copy.ForEachFromBottom([&fromBottom](const std::string& item) { fromBottom.push_back(item); });
+	EXPECT_EQ(fromBottom, std::vector<std::string>({ "bottom", "other top" }));
+}
+
+TEST(PersistentStorage, LongChainIsReleasedWithoutRecursion)
+{
+	const auto numberOfItems = 1000000;
+	ThreadSafeStructs::StackSnapshot<int> snapshot;
+	{
+		ThreadSafeStructs::PersistentStorage<int> storage;
+		for (int number = 0; number < numberOfItems; ++number)
+		{
+			storage.push_back(number);
+		}
+		snapshot = storage.Snapshot();
+	}
+	EXPECT_EQ(snapshot.size(), numberOfItems);
+	EXPECT_EQ(*snapshot.begin(), numberOfItems - 1);
+	snapshot = ThreadSafeStructs::StackSnapshot<int>();
+	EXPECT_TRUE(snapshot.empty());
+}
@@ -0,0 +1,112 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "PoolAllocator.h"
+
+namespace
+{
+	size_t (*poolAllocatedBlocksCount)() = nullptr;
+
+	// Pool allocator which remembers how to read the block count of the pool it was last rebound to,
+	// RWLockStack rebinds to its private chunk type so the test can not name that pool directly.
+	template<typename T>
+	class RecordingPoolAllocator : public ThreadSafeStructs::PoolAllocator<T>
+	{
+	public:
+		RecordingPoolAllocator() noexcept = default;
+		template<typename U>
+		RecordingPoolAllocator(const RecordingPoolAllocator<U>&) noexcept
+		{
+		}
+
+		T* allocate(const size_t count)
+		{
+			poolAllocatedBlocksCount = []()
+				{
+					return ThreadSafeStructs::FixedBlockPool<sizeof(T), alignof(T)>::Instance().AllocatedBlocksCount();
+				};
+			return ThreadSafeStructs::PoolAllocator<T>::allocate(count);
+		}
+	};
+}
+
+TEST(PoolAllocator, FreedBlockIsReused_OneThread)
+{
+	ThreadSafeStructs::PoolAllocator<int64_t> allocator;
+
+	auto first = allocator.allocate(1);
+	allocator.deallocate(first, 1);
+	auto second = allocator.allocate(1);
+	EXPECT_EQ(first, second);
+	allocator.deallocate(second, 1);
+
+	auto array = allocator.allocate(10);
+	array[9] = 9;
+	allocator.deallocate(array, 10);
+}
+
+TEST(PoolAllocator, AllocateAndFreeWithMultipleThreads)
+{
+	const auto numberOfBlocks = 1000;
+	const auto numberOfTestingThreads = 4;
+
+	std::list<std::future<bool>> threadsDone;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsDone.push_back(std::async(std::launch::async, [numberOfBlocks, threadToTest]()
+			{
+				ThreadSafeStructs::PoolAllocator<int64_t> allocator;
+				std::vector<int64_t*> blocks;
+				for (int cycle = 0; cycle < 10; ++cycle)
+				{
+					for (int block = 0; block < numberOfBlocks; ++block)
+					{
+						blocks.push_back(allocator.allocate(1));
+						*blocks.back() = threadToTest * numberOfBlocks + block;
+					}
+					for (int block = 0; block < numberOfBlocks; ++block)
+					{
+						if (*blocks[block] != threadToTest * numberOfBlocks + block)
+						{
+							return false;
+						}
+						allocator.deallocate(blocks[block], 1);
+					}
+					blocks.clear();
+				}
+				return true;
+			}));
+	}
+
+	for (auto& threadDone : threadsDone)
+	{
+		EXPECT_TRUE(threadDone.get());
+	}
+}
+
+TEST(PoolAllocator, SteadyStatePushPopTakesNoNewBlocks_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::DefaultLockPolicy, RecordingPoolAllocator<int>> container;
+	const auto numberOfItems = 10000;
+	auto pushAndPopAll = [numberOfItems, &container]()
+		{
+			for (int number = 0; number < numberOfItems; ++number)
+			{
+				container.Push(number);
+			}
+			int item;
+			while (container.TryPop(item))
+			{
+			}
+		};
+
+	pushAndPopAll();
+	ASSERT_NE(poolAllocatedBlocksCount, nullptr);
+	const auto warmedUpBlocksCount = poolAllocatedBlocksCount();
+
+	for (int cycle = 0; cycle < 10; ++cycle)
+	{
+		pushAndPopAll();
+	}
+	EXPECT_EQ(poolAllocatedBlocksCount(), warmedUpBlocksCount);
+	EXPECT_TRUE(container.Empty());
+}
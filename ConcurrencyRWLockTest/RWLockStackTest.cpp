@@ -82,6 +82,13 @@ namespace
 		return buffer;
 	}
 
+	// Leaves stack untouched, drains a copy of it.
+	std::vector<int> ConvertStackToVector(const std::stack<int>& stack)
+	{
+		auto stackCopy = stack;
+		return ConvertStackToVector(stackCopy);
+	}
+
 	std::stack<int> PushBackStack(const std::stack<int>& first, const std::stack<int>& second)
 	{
 		auto outStack = first;
@@ -94,6 +101,60 @@ namespace
 		return outStack;
 	}
 
+	// Counts how often payloads are copied and moved, reset the counters before the measured part.
+	struct InstrumentedItem
+	{
+		static int32_t copiesCount;
+		static int32_t movesCount;
+
+		static void ResetCounters()
+		{
+			copiesCount = 0;
+			movesCount = 0;
+		}
+
+		InstrumentedItem()
+			: value(0)
+		{
+		}
+
+		explicit InstrumentedItem(const int32_t value)
+			: value(value)
+		{
+		}
+
+		InstrumentedItem(const InstrumentedItem& item)
+			: value(item.value)
+		{
+			++copiesCount;
+		}
+
+		InstrumentedItem(InstrumentedItem&& item) noexcept
+			: value(item.value)
+		{
+			++movesCount;
+		}
+
+		InstrumentedItem& operator=(const InstrumentedItem& item)
+		{
+			value = item.value;
+			++copiesCount;
+			return *this;
+		}
+
+		InstrumentedItem& operator=(InstrumentedItem&& item) noexcept
+		{
+			value = item.value;
+			++movesCount;
+			return *this;
+		}
+
+		int32_t value;
+	};
+
+	int32_t InstrumentedItem::copiesCount = 0;
+	int32_t InstrumentedItem::movesCount = 0;
+
 	int AnalyzeFuturesGetExceptionsCount(std::list<std::future<void>>& threadProcessFinishedFeatures)
 	{
 		uint16_t exceptionCount = 0;
@@ -898,4 +959,1036 @@ TEST(RWLockStack, WhaitAndPopWithTwoThreadsThread)
 	ASSERT_EQ(popThreadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
 
 	EXPECT_EQ(container.Size(), 0);
-}
\ No newline at end of file
+}
+
+TEST(RWLockStack, EliminationArrayHandOffBetweenTwoThreads)
+{
+	ThreadSafeStructs::EliminationArray<int> elimination;
+	const auto numberOfHandOffs = 100;
+	std::atomic<int> takenCount(0);
+	std::atomic<int64_t> takenSum(0);
+
+	auto takeFunction = [numberOfHandOffs, &elimination, &takenCount, &takenSum]()
+		{
+			while (takenCount.load() < numberOfHandOffs)
+			{
+				if (auto offer = elimination.TryClaim())
+				{
+					takenSum += ThreadSafeStructs::EliminationArray<int>::Take(offer);
+					++takenCount;
+				}
+			}
+		};
+	auto takeDone = std::async(std::launch::async, takeFunction);
+
+	int64_t handedOffSum = 0;
+	for (int handOff = 0; handOff < numberOfHandOffs; )
+	{
+		auto item = handOff;
+		if (elimination.TryHandOff(item))
+		{
+			handedOffSum += handOff;
+			++handOff;
+		}
+	}
+	takeDone.get();
+
+	EXPECT_EQ(takenCount.load(), numberOfHandOffs);
+	EXPECT_EQ(takenSum.load(), handedOffSum);
+}
+
+TEST(RWLockStack, EliminationArrayThrowingMoveReleasesPusher)
+{
+	struct ThrowingMoveItem
+	{
+		ThrowingMoveItem(const int value)
+			: value(value)
+		{
+		}
+		ThrowingMoveItem(ThrowingMoveItem&&)
+		{
+			throw std::runtime_error("move failed");
+		}
+
+		int value = 0;
+	};
+
+	ThreadSafeStructs::EliminationArray<ThrowingMoveItem> elimination;
+	std::atomic<bool> moveThrew(false);
+
+	auto takeFunction = [&elimination, &moveThrew]()
+		{
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (!moveThrew.load() && std::chrono::steady_clock::now() < deadline)
+			{
+				if (auto offer = elimination.TryClaim())
+				{
+					EXPECT_THROW(ThreadSafeStructs::EliminationArray<ThrowingMoveItem>::Take(offer), std::runtime_error);
+					moveThrew = true;
+				}
+			}
+		};
+	auto takeDone = std::async(std::launch::async, takeFunction);
+
+	// a rejected offer is not handed off, the pusher keeps its item and comes back
+	ThrowingMoveItem item(7);
+	while (!moveThrew.load() && takeDone.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		EXPECT_FALSE(elimination.TryHandOff(item));
+	}
+	takeDone.get();
+
+	EXPECT_TRUE(moveThrew.load());
+	EXPECT_EQ(item.value, 7);
+}
+
+TEST(RWLockStack, PushAndTryPopWithMultipleThreads)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	std::atomic<int64_t> pushedSum(0);
+	std::atomic<int64_t> popedSum(0);
+	const auto numberOfGeneratedNumbers = 10000;
+	const auto numberOfTestingThreads = 8;
+
+	auto pushAndPopFunction = [numberOfGeneratedNumbers, &container, &pushedSum, &popedSum]()
+		{
+			for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers; ++numbersGenerated)
+			{
+				container.Push(numbersGenerated);
+				pushedSum += numbersGenerated;
+				popedSum += container.TryPop();
+			}
+		};
+
+	TestThreadsManager<decltype(pushAndPopFunction), int> threadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(pushAndPopFunction), int>>(
+				pushAndPopFunction,
+				threadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	threadsManger.WaitThreadFinished();
+
+	ASSERT_EQ(threadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
+	ASSERT_EQ(threadsManger.GetThreadsProcessedExceptionsCount(), 0);
+
+	EXPECT_EQ(pushedSum.load(), popedSum.load());
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, PushRangeRWStackWithMoveSplicesAllItems_OneThread)
+{
+	const auto numberOfGeneratedNumbers = 10000;
+	auto stackOrign = GetRandomStack(10, MIN_MAX_RANDOM_VALUES);
+	auto stackToAppend = GetRandomStack(numberOfGeneratedNumbers, MIN_MAX_RANDOM_VALUES);
+
+	ThreadSafeStructs::RWLockStack<int> container(stackOrign);
+	ThreadSafeStructs::RWLockStack<int> containerToAppend(stackToAppend);
+
+	container.PushRange(std::move(containerToAppend));
+
+	EXPECT_TRUE(containerToAppend.Empty());
+	ASSERT_EQ(container.Size(), numberOfGeneratedNumbers + 10);
+
+	auto stackExpected = PushBackStack(stackOrign, stackToAppend);
+	while (!stackExpected.empty())
+	{
+		ASSERT_EQ(stackExpected.top(), container.TryPop());
+		stackExpected.pop();
+	}
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, PushRangeStackAndExportKeepOrder_OneThread)
+{
+	auto stackOrign = GetRandomStack(100, MIN_MAX_RANDOM_VALUES);
+	auto stackToAppend = GetRandomStack(1000, MIN_MAX_RANDOM_VALUES);
+
+	ThreadSafeStructs::RWLockStack<int> container(stackOrign);
+	container.PushRange(stackToAppend);
+	container.PushRange(container);
+
+	auto stackExpected = PushBackStack(stackOrign, stackToAppend);
+	stackExpected = PushBackStack(stackExpected, stackExpected);
+
+	EXPECT_EQ(container.ExportOrignContainer(), stackExpected);
+}
+
+TEST(RWLockStack, TryPopWithoutExceptionFromEmptyContainer_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	int item = -1;
+
+	EXPECT_FALSE(container.TryPop(item));
+	EXPECT_EQ(item, -1);
+
+	container.Push(5);
+	EXPECT_TRUE(container.TryPop(item));
+	EXPECT_EQ(item, 5);
+	EXPECT_FALSE(container.TryPop(item));
+}
+
+TEST(RWLockStack, PopItemFromEmptyContainerThrowingAndNotThrowing_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	const auto numberOfPopAttempts = 100;
+	auto exceptionsCount = 0;
+	auto failedPopsCount = 0;
+
+	for (int popAttempt = 0; popAttempt < numberOfPopAttempts; ++popAttempt)
+	{
+		try
+		{
+			container.TryPop();
+		}
+		catch (const ThreadSafeStructs::ThreadSafetyException&)
+		{
+			++exceptionsCount;
+		}
+		int item = -1;
+		if (!container.TryPop(item))
+		{
+			++failedPopsCount;
+		}
+		ASSERT_EQ(item, -1);
+	}
+
+	EXPECT_EQ(exceptionsCount, numberOfPopAttempts);
+	EXPECT_EQ(failedPopsCount, numberOfPopAttempts);
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, PopNItemsInLIFOOrder_OneThread)
+{
+	auto stackOrign = GetRandomStack(10, MIN_MAX_RANDOM_VALUES);
+	ThreadSafeStructs::RWLockStack<int> container(stackOrign);
+
+	auto popedItems = container.PopN(4);
+	std::vector<int> restItems;
+	auto restCount = container.PopN(100, std::back_inserter(restItems));
+
+	ASSERT_EQ(popedItems.size(), 4);
+	ASSERT_EQ(restCount, 6);
+	EXPECT_TRUE(container.Empty());
+
+	popedItems.insert(popedItems.end(), restItems.begin(), restItems.end());
+	EXPECT_EQ(popedItems, ConvertStackToVector(stackOrign));
+	EXPECT_TRUE(container.PopN(10).empty());
+}
+
+TEST(RWLockStack, PopNKeepsCountsWhenOutputThrows_OneThread)
+{
+	struct ThrowingOutput
+	{
+		using iterator_category = std::output_iterator_tag;
+		using value_type = void;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = void;
+
+		ThrowingOutput& operator*() { return *this; }
+		ThrowingOutput& operator++() { return *this; }
+		ThrowingOutput& operator=(int item)
+		{
+			if (*assignmentsLeft == 0)
+			{
+				throw std::runtime_error("output is full");
+			}
+			--*assignmentsLeft;
+			items->push_back(item);
+			return *this;
+		}
+
+		int* assignmentsLeft;
+		std::vector<int>* items;
+	};
+
+	auto lowWatermarkCalls = 0;
+	ThreadSafeStructs::StackCapacity capacity;
+	capacity.capacity = 10;
+	capacity.highWatermark = 8;
+	capacity.lowWatermark = 4;
+	capacity.onLowWatermark = [&lowWatermarkCalls]() { ++lowWatermarkCalls; };
+	ThreadSafeStructs::RWLockStack<int> container(capacity);
+	for (int number = 0; number < 10; ++number)
+	{
+		container.Push(number);
+	}
+
+	auto assignmentsLeft = 6;
+	std::vector<int> popedItems;
+	EXPECT_THROW(container.PopN(10, ThrowingOutput{ &assignmentsLeft, &popedItems }), std::runtime_error);
+	EXPECT_EQ(popedItems, std::vector<int>({ 9, 8, 7, 6, 5, 4 }));
+	EXPECT_EQ(container.Size(), 4);
+	EXPECT_EQ(lowWatermarkCalls, 1);
+	container.Push(10).Push(11);
+	EXPECT_EQ(container.Size(), 6);
+	EXPECT_EQ(container.TryPop(), 11);
+}
+
+TEST(RWLockStack, PopNWithMultipleThreadsNoOneElementLeft)
+{
+	const auto numberOfBatches = 100;
+	const auto batchSize = 10;
+	const auto numberOfTestingThreads = 10;
+
+	ThreadSafeStructs::RWLockStack<int> container(GetRandomStack(numberOfBatches * batchSize * numberOfTestingThreads, MIN_MAX_RANDOM_VALUES));
+	std::atomic<int32_t> popedCount(0);
+
+	auto popFunction = [numberOfBatches, batchSize, &container, &popedCount]()
+		{
+			for (int batch = 0; batch < numberOfBatches; ++batch)
+			{
+				popedCount += static_cast<int32_t>(container.PopN(batchSize).size());
+			}
+		};
+
+	TestThreadsManager<decltype(popFunction), int> threadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(popFunction), int>>(
+				popFunction,
+				threadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	threadsManger.WaitThreadFinished();
+
+	ASSERT_EQ(threadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
+	ASSERT_EQ(threadsManger.GetThreadsProcessedExceptionsCount(), 0);
+	EXPECT_EQ(popedCount.load(), numberOfBatches * batchSize * numberOfTestingThreads);
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, BoundedContainerRejectsItemsWhenFull_OneThread)
+{
+	ThreadSafeStructs::StackCapacity capacity;
+	capacity.capacity = 3;
+	ThreadSafeStructs::RWLockStack<int> container(capacity);
+
+	EXPECT_TRUE(container.TryPush(1));
+	EXPECT_TRUE(container.TryPush(2));
+	container.Push(3);
+
+	EXPECT_FALSE(container.TryPush(4));
+	EXPECT_THROW(container.Push(4), ThreadSafeStructs::ThreadSafetyException);
+	EXPECT_THROW(container.PushRange(GetRandomStack(1, MIN_MAX_RANDOM_VALUES)), ThreadSafeStructs::ThreadSafetyException);
+	EXPECT_FALSE(container.WaitAndPushFor(4, std::chrono::milliseconds(10)));
+	EXPECT_EQ(container.Size(), 3);
+
+	EXPECT_EQ(container.TryPop(), 3);
+	EXPECT_TRUE(container.TryPush(4));
+	EXPECT_EQ(container.TryPop(), 4);
+}
+
+TEST(RWLockStack, BoundedContainerWaitAndPushWithTwoThreads)
+{
+	ThreadSafeStructs::StackCapacity capacity;
+	capacity.capacity = 5;
+	ThreadSafeStructs::RWLockStack<int> container(capacity);
+	const auto numberOfGeneratedNumbers = 1000;
+
+	auto pushDone = std::async(std::launch::async, [numberOfGeneratedNumbers, &container]()
+		{
+			for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers; ++numbersGenerated)
+			{
+				container.WaitAndPush(numbersGenerated);
+			}
+		});
+
+	auto popedCount = 0;
+	while (popedCount < numberOfGeneratedNumbers)
+	{
+		int item;
+		if (container.TryPop(item))
+		{
+			++popedCount;
+		}
+		ASSERT_LE(container.Size(), 5);
+	}
+	pushDone.get();
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, BoundedContainerWatermarkCallbacks_OneThread)
+{
+	auto highWatermarkCalls = 0;
+	auto lowWatermarkCalls = 0;
+	ThreadSafeStructs::StackCapacity capacity;
+	capacity.capacity = 10;
+	capacity.highWatermark = 8;
+	capacity.lowWatermark = 2;
+	capacity.onHighWatermark = [&highWatermarkCalls]() { ++highWatermarkCalls; };
+	capacity.onLowWatermark = [&lowWatermarkCalls]() { ++lowWatermarkCalls; };
+	ThreadSafeStructs::RWLockStack<int> container(capacity);
+
+	for (int number = 0; number < 9; ++number)
+	{
+		container.Push(number);
+	}
+	EXPECT_EQ(highWatermarkCalls, 1);
+	EXPECT_EQ(lowWatermarkCalls, 0);
+
+	container.PopN(6);
+	EXPECT_EQ(lowWatermarkCalls, 0);
+	container.TryPop();
+	EXPECT_EQ(lowWatermarkCalls, 1);
+
+	container.PushRange(GetRandomStack(6, MIN_MAX_RANDOM_VALUES));
+	EXPECT_EQ(highWatermarkCalls, 2);
+	EXPECT_EQ(container.Capacity(), 10);
+}
+
+TEST(RWLockStack, BoundedContainerRejectedRangeStaysInSource_OneThread)
+{
+	ThreadSafeStructs::StackCapacity capacity;
+	capacity.capacity = 3;
+	ThreadSafeStructs::RWLockStack<int> container(capacity);
+	container.Push(1).Push(2);
+
+	ThreadSafeStructs::RWLockStack<int> containerToAppend;
+	containerToAppend.Push(3).Push(4);
+	EXPECT_THROW(container.PushRange(std::move(containerToAppend)), ThreadSafeStructs::ThreadSafetyException);
+	EXPECT_EQ(containerToAppend.Size(), 2);
+	EXPECT_EQ(containerToAppend.TryPop(), 4);
+
+	std::stack<int> stackToAppend;
+	stackToAppend.push(5);
+	stackToAppend.push(6);
+	EXPECT_THROW(container.PushRange(std::move(stackToAppend)), ThreadSafeStructs::ThreadSafetyException);
+	ASSERT_EQ(stackToAppend.size(), 2);
+	EXPECT_EQ(stackToAppend.top(), 6);
+	stackToAppend.pop();
+	EXPECT_EQ(stackToAppend.top(), 5);
+
+	container.PushRange(std::move(containerToAppend));
+	EXPECT_TRUE(containerToAppend.Empty());
+	EXPECT_EQ(container.TryPop(), 3);
+	EXPECT_EQ(container.Size(), 2);
+}
+
+TEST(RWLockStack, DrainedBoundedContainerWakesWaitAndPush)
+{
+	auto lowWatermarkCalls = 0;
+	ThreadSafeStructs::StackCapacity capacity;
+	capacity.capacity = 2;
+	capacity.highWatermark = 2;
+	capacity.onLowWatermark = [&lowWatermarkCalls]() { ++lowWatermarkCalls; };
+	ThreadSafeStructs::RWLockStack<int> source(capacity);
+	ThreadSafeStructs::RWLockStack<int> container;
+
+	auto drainBlockedSource = [&source](auto drain)
+		{
+			source.Push(1).Push(2);
+			auto pushDone = std::async(std::launch::async, [&source]() { source.WaitAndPush(3); });
+			EXPECT_EQ(pushDone.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+			drain();
+			EXPECT_EQ(pushDone.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+			EXPECT_EQ(source.TryPop(), 3);
+		};
+
+	drainBlockedSource([&source, &container]() { container.PushRange(std::move(source)); });
+	EXPECT_EQ(lowWatermarkCalls, 1);
+	EXPECT_EQ(container.Size(), 2);
+
+	drainBlockedSource([&source]() { ThreadSafeStructs::RWLockStack<int> moved(std::move(source)); EXPECT_EQ(moved.Size(), 2); });
+	EXPECT_EQ(lowWatermarkCalls, 2);
+	EXPECT_EQ(source.Capacity(), 2);
+}
+
+TEST(RWLockStack, WaitAndPopForTimesOutOnEmptyContainer_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	int item = -1;
+
+	EXPECT_FALSE(container.WaitAndPopFor(item, std::chrono::milliseconds(10)));
+	EXPECT_EQ(item, -1);
+
+	container.Push(5);
+	EXPECT_TRUE(container.WaitAndPopFor(item, std::chrono::milliseconds(10)));
+	EXPECT_EQ(item, 5);
+}
+
+TEST(RWLockStack, WhaitAndPopWakesAllWaitersOnPushRange)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	const auto numberOfTestingThreads = 10;
+
+	auto popFunction = [&container]()
+		{
+			container.WhaitAndPop();
+		};
+
+	TestThreadsManager<decltype(popFunction), int> popThreadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		popThreadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(popFunction), int>>(
+				popFunction,
+				popThreadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+
+	auto pushDone = std::async(std::launch::async, [numberOfTestingThreads, &container]()
+		{
+			// give consumers a chance to block first
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			container.PushRange(GetRandomStack(numberOfTestingThreads / 2, MIN_MAX_RANDOM_VALUES));
+			container.PushRange(GetRandomStack(numberOfTestingThreads - numberOfTestingThreads / 2, MIN_MAX_RANDOM_VALUES));
+		});
+	popThreadsManger.WaitThreadFinished();
+	pushDone.get();
+
+	ASSERT_EQ(popThreadsManger.GetThreadsProcessedExceptionsCount(), 0);
+	ASSERT_EQ(popThreadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, SizePolledWhileMultipleThreadsPush)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	const auto numberOfGeneratedNumbers = 1000;
+	const auto numberOfTestingThreads = 4;
+	std::atomic<bool> pushesFinished(false);
+
+	auto pollDone = std::async(std::launch::async, [&container, &pushesFinished]()
+		{
+			uint32_t previousSize = 0;
+			while (!pushesFinished.load())
+			{
+				const auto size = container.Size();
+				if (size < previousSize)
+				{
+					throw std::runtime_error("Size decreased while only pushes were running");
+				}
+				previousSize = size;
+			}
+		});
+
+	auto pushFunction = [numberOfGeneratedNumbers, &container]()
+		{
+			for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers; ++numbersGenerated)
+			{
+				container.Push(numbersGenerated);
+			}
+		};
+
+	TestThreadsManager<decltype(pushFunction), int> threadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(pushFunction), int>>(
+				pushFunction,
+				threadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	threadsManger.WaitThreadFinished();
+	pushesFinished.store(true);
+
+	EXPECT_NO_THROW(pollDone.get());
+	ASSERT_EQ(threadsManger.GetThreadsProcessedExceptionsCount(), 0);
+	EXPECT_EQ(container.Size(), numberOfGeneratedNumbers * numberOfTestingThreads);
+	EXPECT_FALSE(container.Empty());
+}
+
+TEST(RWLockStack, AtomicWaitAndPopWithMultipleThreads)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	const auto numberOfGeneratedNumbers = 1000;
+	const auto numberOfTestingThreads = 4;
+	std::atomic<int64_t> popedSum(0);
+
+	auto popFunction = [numberOfGeneratedNumbers, &container, &popedSum]()
+		{
+			for (int numbersPoped = 0; numbersPoped < numberOfGeneratedNumbers; ++numbersPoped)
+			{
+				popedSum += container.AtomicWaitAndPop();
+			}
+		};
+
+	TestThreadsManager<decltype(popFunction), int> popThreadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		popThreadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(popFunction), int>>(
+				popFunction,
+				popThreadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+
+	int64_t pushedSum = 0;
+	for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers * numberOfTestingThreads; ++numbersGenerated)
+	{
+		container.Push(numbersGenerated);
+		pushedSum += numbersGenerated;
+	}
+	popThreadsManger.WaitThreadFinished();
+
+	ASSERT_EQ(popThreadsManger.GetThreadsProcessedExceptionsCount(), 0);
+	ASSERT_EQ(popThreadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
+	EXPECT_EQ(popedSum.load(), pushedSum);
+	EXPECT_TRUE(container.Empty());
+}
+
+template<typename Container>
+class RWLockStackContainers : public ::testing::Test
+{
+public:
+	using Stack = ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::DefaultLockPolicy, std::allocator<int>, Container>;
+};
+
+using BackingContainers = ::testing::Types<
+	ThreadSafeStructs::SegmentedStorage<int>,
+	std::vector<int>,
+	std::deque<int>,
+#ifndef THREAD_SAFE_STRUCTS_NO_BOOST
+	boost::container::small_vector<int, 16>,
+#endif
+	ThreadSafeStructs::PersistentStorage<int>>;
+TYPED_TEST_SUITE(RWLockStackContainers, BackingContainers);
+
+TYPED_TEST(RWLockStackContainers, PushRangeAndPopKeepLIFOOrder_OneThread)
+{
+	typename TestFixture::Stack container;
+	typename TestFixture::Stack otherContainer;
+	for (int number = 0; number < 50; ++number)
+	{
+		container.Push(number);
+		otherContainer.Push(number + 50);
+	}
+	container.PushRange(std::move(otherContainer));
+	EXPECT_TRUE(otherContainer.Empty());
+
+	auto exported = container.ExportOrignContainer();
+	ASSERT_EQ(exported.size(), 100);
+	for (int number = 99; number >= 0; --number)
+	{
+		ASSERT_EQ(exported.top(), number);
+		exported.pop();
+		ASSERT_EQ(container.TryPop(), number);
+	}
+	EXPECT_TRUE(container.Empty());
+}
+
+TYPED_TEST(RWLockStackContainers, ShrinkToFitGivesMemoryBack_OneThread)
+{
+	typename TestFixture::Stack container;
+	container.Reserve(1000);
+	for (int number = 0; number < 1000; ++number)
+	{
+		container.Push(number);
+	}
+	EXPECT_GE(container.StorageCapacity(), 1000);
+	const auto fullMemoryUsage = container.MemoryUsage();
+
+	while (!container.Empty())
+	{
+		container.TryPop();
+	}
+	container.ShrinkToFit();
+	EXPECT_LT(container.MemoryUsage(), fullMemoryUsage);
+}
+
+TEST(RWLockStack, ReservedStorageDoesNotGrowOnPush_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	container.Reserve(1000);
+	EXPECT_GE(container.StorageCapacity(), 1000);
+	const auto reservedMemoryUsage = container.MemoryUsage();
+
+	for (int cycle = 0; cycle < 3; ++cycle)
+	{
+		for (int number = 0; number < 1000; ++number)
+		{
+			container.Push(number);
+		}
+		ASSERT_EQ(container.MemoryUsage(), reservedMemoryUsage);
+		container.PopN(1000);
+		ASSERT_EQ(container.MemoryUsage(), reservedMemoryUsage);
+	}
+}
+
+TEST(RWLockStack, CopyOfBoundedContainerKeepsPreallocatedStorage_OneThread)
+{
+	ThreadSafeStructs::StackCapacity capacity;
+	capacity.capacity = 10000;
+	ThreadSafeStructs::RWLockStack<int> origin(capacity);
+	origin.Push(1).Push(2);
+
+	ThreadSafeStructs::RWLockStack<int> container(origin);
+	EXPECT_EQ(container.Capacity(), 10000);
+	EXPECT_GE(container.StorageCapacity(), 10000);
+	const auto reservedMemoryUsage = container.MemoryUsage();
+	for (int cycle = 0; cycle < 3; ++cycle)
+	{
+		for (int number = 0; number < 9998; ++number)
+		{
+			container.Push(number);
+		}
+		ASSERT_EQ(container.MemoryUsage(), reservedMemoryUsage);
+		container.PopN(9998);
+		ASSERT_EQ(container.MemoryUsage(), reservedMemoryUsage);
+	}
+	EXPECT_EQ(container.TryPop(), 2);
+}
+
+TEST(RWLockStack, SnapshotStaysConsistentWhileWriterPushes)
+{
+	ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::DefaultLockPolicy, std::allocator<int>,
+		ThreadSafeStructs::PersistentStorage<int>> container;
+	const auto numberOfGeneratedNumbers = 100000;
+	std::atomic<bool> pushesFinished(false);
+
+	auto readDone = std::async(std::launch::async, [&container, &pushesFinished]()
+		{
+			int32_t snapshotsCount = 0;
+			while (!pushesFinished.load())
+			{
+				// the writer pushes increasing numbers and pops every tenth, so a consistent
+				// version is strictly decreasing from the top and exactly Size() long
+				auto snapshot = container.Snapshot();
+				size_t walkedCount = 0;
+				auto previous = std::numeric_limits<int>::max();
+				for (const auto& item : snapshot)
+				{
+					if (item >= previous)
+					{
+						throw std::runtime_error("Snapshot is not a consistent version of the stack");
+					}
+					previous = item;
+					++walkedCount;
+				}
+				if (walkedCount != snapshot.size())
+				{
+					throw std::runtime_error("Snapshot size does not match its items");
+				}
+				++snapshotsCount;
+			}
+			return snapshotsCount;
+		});
+
+	for (int number = 0; number < numberOfGeneratedNumbers; ++number)
+	{
+		container.Push(number);
+		if (number % 10 == 9)
+		{
+			container.TryPop();
+		}
+	}
+	pushesFinished.store(true);
+
+	int32_t snapshotsCount = 0;
+	EXPECT_NO_THROW(snapshotsCount = readDone.get());
+	EXPECT_GT(snapshotsCount, 0);
+	EXPECT_EQ(container.Snapshot().size(), numberOfGeneratedNumbers - numberOfGeneratedNumbers / 10);
+}
+
+TEST(RWLockStack, SnapshotOfSegmentedStorageIsCopy_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	container.Push(1).Push(2);
+
+	auto snapshot = container.Snapshot();
+	container.TryPop();
+
+	ASSERT_EQ(snapshot.size(), 2);
+	EXPECT_EQ(std::vector<int>(snapshot.begin(), snapshot.end()), std::vector<int>({ 2, 1 }));
+}
+
+TEST(RWLockStack, PushAndPopWithMoveDoNotCopy_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<InstrumentedItem> container;
+	InstrumentedItem::ResetCounters();
+
+	InstrumentedItem item(1);
+	container.Push(std::move(item));
+	container.Emplace(2);
+	EXPECT_EQ(InstrumentedItem::copiesCount, 0);
+	EXPECT_EQ(InstrumentedItem::movesCount, 1);
+
+	InstrumentedItem popedItem;
+	ASSERT_TRUE(container.TryPop(popedItem));
+	EXPECT_EQ(popedItem.value, 2);
+	EXPECT_EQ(container.TryPop().value, 1);
+	EXPECT_EQ(InstrumentedItem::copiesCount, 0);
+
+	container.Push(popedItem);
+	EXPECT_EQ(InstrumentedItem::copiesCount, 1);
+	container.WhaitAndPop();
+	EXPECT_EQ(InstrumentedItem::copiesCount, 1);
+}
+
+TEST(RWLockStack, PushRangeWithMoveDoesNotCopy_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<InstrumentedItem> container;
+	ThreadSafeStructs::RWLockStack<InstrumentedItem> otherContainer;
+	std::stack<InstrumentedItem> orignContainer;
+	for (int32_t number = 0; number < 100; ++number)
+	{
+		otherContainer.Emplace(number);
+		orignContainer.emplace(number);
+	}
+	InstrumentedItem::ResetCounters();
+
+	container.PushRange(std::move(otherContainer));
+	container.PushRange(std::move(orignContainer));
+	EXPECT_EQ(InstrumentedItem::copiesCount, 0);
+	EXPECT_EQ(container.Size(), 200);
+
+	auto popedItems = container.PopN(200);
+	EXPECT_EQ(InstrumentedItem::copiesCount, 0);
+	ASSERT_EQ(popedItems.size(), 200);
+	EXPECT_EQ(popedItems.front().value, 99);
+}
+
+TEST(RWLockStack, MoveOnlyItems_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<std::unique_ptr<int>> container;
+	container.Push(std::make_unique<int>(1));
+	container.Emplace(new int(2));
+	ASSERT_TRUE(container.TryPush(std::make_unique<int>(3)));
+
+	std::unique_ptr<int> item;
+	ASSERT_TRUE(container.TryPop(item));
+	EXPECT_EQ(*item, 3);
+	EXPECT_EQ(*container.TryPop(), 2);
+	EXPECT_EQ(*container.WhaitAndPop(), 1);
+	EXPECT_FALSE(container.WaitAndPopFor(item, std::chrono::milliseconds(1)));
+
+	std::stack<std::unique_ptr<int>> orignContainer;
+	orignContainer.push(std::make_unique<int>(4));
+	ThreadSafeStructs::RWLockStack<std::unique_ptr<int>> otherContainer(std::move(orignContainer));
+	otherContainer.Push(std::make_unique<int>(5));
+	container.PushRange(std::move(otherContainer));
+
+	auto popedItems = container.PopN(2);
+	ASSERT_EQ(popedItems.size(), 2);
+	EXPECT_EQ(*popedItems[0], 5);
+	EXPECT_EQ(*popedItems[1], 4);
+	EXPECT_TRUE(container.Empty());
+}
+
+TYPED_TEST(RWLockStackContainers, PeekAndForEachVisitFromTop_OneThread)
+{
+	typename TestFixture::Stack container;
+	EXPECT_FALSE(container.Peek().has_value());
+	EXPECT_FALSE(container.VisitTop([](const int&) { FAIL(); }));
+
+	for (int number = 0; number < 100; ++number)
+	{
+		container.Push(number);
+	}
+	EXPECT_EQ(container.Peek(), 99);
+	int top = -1;
+	EXPECT_TRUE(container.VisitTop([&top](const int& item) { top = item; }));
+	EXPECT_EQ(top, 99);
+
+	std::vector<int> visited;
+	container.ForEach([&visited](const int& item) { visited.push_back(item); });
+	ASSERT_EQ(visited.size(), 100);
+	EXPECT_EQ(visited.front(), 99);
+	EXPECT_EQ(visited.back(), 0);
+
+	visited.clear();
+	container.ForEachTopN(3, [&visited](const int& item) { visited.push_back(item); });
+	EXPECT_EQ(visited, std::vector<int>({ 99, 98, 97 }));
+	EXPECT_EQ(container.Size(), 100);
+}
+
+TEST(RWLockStack, ReadersVisitTopInParallel)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	container.Push(1);
+	const auto numberOfReaders = 4;
+	std::atomic<int> readersInside(0);
+
+	auto readFunction = [numberOfReaders, &container, &readersInside]()
+		{
+			auto allReadersMet = false;
+			container.VisitTop([numberOfReaders, &readersInside, &allReadersMet](const int&)
+				{
+					// holds the shared lock until every reader is inside or the deadline passes
+					++readersInside;
+					const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+					while (readersInside.load() < numberOfReaders && std::chrono::steady_clock::now() < deadline)
+					{
+						std::this_thread::yield();
+					}
+					allReadersMet = readersInside.load() == numberOfReaders;
+				});
+			return allReadersMet;
+		};
+
+	std::list<std::future<bool>> readersDone;
+	for (int reader = 0; reader < numberOfReaders; ++reader)
+	{
+		readersDone.push_back(std::async(std::launch::async, readFunction));
+	}
+	for (auto& readerDone : readersDone)
+	{
+		EXPECT_TRUE(readerDone.get());
+	}
+}
+
+namespace
+{
+	// Starts eagerly and frees its frame when it returns, enough to drive PopAsync from a test.
+	struct DetachedTask
+	{
+		struct promise_type
+		{
+			DetachedTask get_return_object() noexcept { return DetachedTask(); }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept { std::terminate(); }
+		};
+	};
+
+	template<typename Stack, typename... Executor>
+	DetachedTask PopAsyncInto(Stack& container, std::optional<int>& item, Executor... executor)
+	{
+		item = co_await container.PopAsync(executor...);
+	}
+
+	// Queues resumed coroutines, the test thread runs them, as a coroutine executor would.
+	struct QueueExecutor
+	{
+		std::vector<std::coroutine_handle<>>* queue;
+
+		void operator()(std::coroutine_handle<> coroutine) const
+		{
+			queue->push_back(coroutine);
+		}
+	};
+}
+
+TEST(RWLockStack, PopAsyncOnNonEmptyStackDoesNotSuspend_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	container.Push(1).Push(2);
+
+	std::optional<int> item;
+	PopAsyncInto(container, item);
+	EXPECT_EQ(item, 2);
+	EXPECT_EQ(container.Size(), 1);
+}
+
+TEST(RWLockStack, PopAsyncResumesOnPushingThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	std::optional<int> item;
+	std::thread::id resumedOn;
+	[](ThreadSafeStructs::RWLockStack<int>& container, std::optional<int>& item, std::thread::id& resumedOn) -> DetachedTask
+		{
+			item = co_await container.PopAsync();
+			resumedOn = std::this_thread::get_id();
+		}(container, item, resumedOn);
+	EXPECT_FALSE(item.has_value());
+
+	std::thread pusher([&container]() { container.Push(7); });
+	const auto pusherId = pusher.get_id();
+	pusher.join();
+
+	EXPECT_EQ(item, 7);
+	EXPECT_EQ(resumedOn, pusherId);
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, PopAsyncResumesThroughExecutor_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	std::vector<std::coroutine_handle<>> queue;
+	std::optional<int> item;
+	PopAsyncInto(container, item, QueueExecutor{ &queue });
+
+	container.Push(3);
+	EXPECT_FALSE(item.has_value());
+	ASSERT_EQ(queue.size(), 1);
+	EXPECT_TRUE(container.Empty());
+
+	queue.front().resume();
+	EXPECT_EQ(item, 3);
+}
+
+TEST(RWLockStack, PopAsyncWaitersAreServedInOrder_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	std::vector<std::optional<int>> items(3);
+	for (auto& item : items)
+	{
+		PopAsyncInto(container, item);
+	}
+
+	container.Push(0);
+	EXPECT_EQ(items[0], 0);
+	EXPECT_FALSE(items[1].has_value());
+
+	// a range serves the longest waiting coroutine with the top item
+	std::stack<int> range;
+	range.push(2);
+	range.push(1);
+	container.PushRange(range).Push(5);
+	EXPECT_EQ(items[1], 1);
+	EXPECT_EQ(items[2], 2);
+	EXPECT_EQ(container.TryPop(), 5);
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, PopAsyncThousandsOfWaitersOnFewThreads)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	const auto numberOfWaiters = 4000;
+	const auto numberOfTestingThreads = 4;
+	std::vector<std::optional<int>> items(numberOfWaiters);
+	for (auto& item : items)
+	{
+		PopAsyncInto(container, item);
+	}
+
+	auto pushFunction = [numberOfWaiters, numberOfTestingThreads, &container]()
+		{
+			for (int numbersPushed = 0; numbersPushed < numberOfWaiters / numberOfTestingThreads; ++numbersPushed)
+			{
+				container.Push(1);
+			}
+			return 0;
+		};
+
+	TestThreadsManager<decltype(pushFunction), int> pushThreadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		pushThreadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(pushFunction), int>>(
+				pushFunction,
+				pushThreadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	pushThreadsManger.WaitThreadFinished();
+
+	ASSERT_EQ(pushThreadsManger.GetThreadsProcessedExceptionsCount(), 0);
+	EXPECT_TRUE(std::all_of(items.begin(), items.end(), [](const std::optional<int>& item) { return item == 1; }));
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(RWLockStack, PopAsyncMoveOnlyItems_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<std::unique_ptr<int>> container;
+	std::unique_ptr<int> item;
+	[](ThreadSafeStructs::RWLockStack<std::unique_ptr<int>>& container, std::unique_ptr<int>& item) -> DetachedTask
+		{
+			item = co_await container.PopAsync();
+		}(container, item);
+
+	container.Push(std::make_unique<int>(9));
+	ASSERT_NE(item, nullptr);
+	EXPECT_EQ(*item, 9);
+}
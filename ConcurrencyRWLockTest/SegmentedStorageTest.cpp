@@ -0,0 +1,90 @@
+#include "stdfx.h"
+#include "SegmentedStorage.h"
+
+namespace
+{
+	using SmallChunksStorage = ThreadSafeStructs::SegmentedStorage<int, 4>;
+
+	std::vector<int> ConvertStorageToVector(const SmallChunksStorage& storage)
+	{
+		std::vector<int> buffer;
+		storage.ForEachFromBottom([&buffer](const int item) { buffer.push_back(item); });
+		return buffer;
+	}
+
+	SmallChunksStorage GetSequenceStorage(const int first, const int count)
+	{
+		SmallChunksStorage storage;
+		for (int number = first; number < first + count; ++number)
+		{
+			storage.push_back(number);
+		}
+		return storage;
+	}
+}
+
+TEST(SegmentedStorage, PushPopAcrossChunks)
+{
+	auto storage = GetSequenceStorage(0, 10);
+	ASSERT_EQ(storage.size(), 10);
+
+	for (int number = 9; number >= 0; --number)
+	{
+		ASSERT_EQ(storage.back(), number);
+		storage.pop_back();
+	}
+	EXPECT_TRUE(storage.empty());
+
+	storage.push_back(42);
+	EXPECT_EQ(storage.back(), 42);
+}
+
+TEST(SegmentedStorage, SpliceKeepsOrderAndEmptiesSource)
+{
+	auto storage = GetSequenceStorage(0, 7);
+	auto appended = GetSequenceStorage(7, 9);
+
+	storage.Splice(std::move(appended));
+
+	EXPECT_TRUE(appended.empty());
+	ASSERT_EQ(storage.size(), 16);
+
+	std::vector<int> expected(16);
+	std::iota(expected.begin(), expected.end(), 0);
+	EXPECT_EQ(ConvertStorageToVector(storage), expected);
+
+	for (int number = 15; number >= 0; --number)
+	{
+		ASSERT_EQ(storage.back(), number);
+		storage.pop_back();
+	}
+	EXPECT_TRUE(storage.empty());
+}
+
+TEST(SegmentedStorage, SpliceSmallStorageIntoPartialChunk)
+{
+	auto storage = GetSequenceStorage(0, 1);
+	auto appended = GetSequenceStorage(1, 2);
+
+	storage.Splice(std::move(appended));
+	storage.push_back(3);
+
+	EXPECT_TRUE(appended.empty());
+	EXPECT_EQ(ConvertStorageToVector(storage), std::vector<int>({ 0, 1, 2, 3 }));
+
+	appended.push_back(4);
+	EXPECT_EQ(appended.back(), 4);
+}
+
+TEST(SegmentedStorage, CopyIsIndependent)
+{
+	auto storage = GetSequenceStorage(0, 10);
+	auto copy = storage;
+
+	storage.pop_back();
+	storage.push_back(100);
+
+	EXPECT_EQ(copy.size(), 10);
+	EXPECT_EQ(copy.back(), 9);
+	EXPECT_EQ(storage.back(), 100);
+}
@@ -0,0 +1,105 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "ShardedStack.h"
+#include "ThreadSafeException.h"
+#include "RWLStackTestUtils.h"
+#include "SeparatedThreadCallbackExecutor.h"
+
+TEST(ShardedStack, CreateContainer_Empty)
+{
+	ThreadSafeStructs::ShardedStack<int> container(4);
+
+	EXPECT_TRUE(container.Empty());
+	EXPECT_EQ(container.Size(), 0);
+	EXPECT_EQ(container.ShardsCount(), 4);
+	EXPECT_THROW(container.TryPop(), ThreadSafeStructs::ThreadSafetyException);
+}
+
+TEST(ShardedStack, PushPopItemsKeepLIFOOrderInOneThread)
+{
+	ThreadSafeStructs::ShardedStack<int> container(4);
+
+	for (int number = 0; number < 100; ++number)
+	{
+		container.Push(number);
+	}
+	ASSERT_EQ(container.Size(), 100);
+
+	for (int number = 99; number >= 0; --number)
+	{
+		ASSERT_EQ(container.TryPop(), number);
+	}
+	int item;
+	EXPECT_FALSE(container.TryPop(item));
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(ShardedStack, PopStealsItemsPushedByOtherThread)
+{
+	ThreadSafeStructs::ShardedStack<int> container(4);
+	const auto numberOfGeneratedNumbers = 100;
+
+	std::async(std::launch::async, [numberOfGeneratedNumbers, &container]()
+		{
+			for (int number = 0; number < numberOfGeneratedNumbers; ++number)
+			{
+				container.Push(number);
+			}
+		}).get();
+
+	int64_t popedSum = 0;
+	int item;
+	while (container.TryPop(item))
+	{
+		popedSum += item;
+	}
+	EXPECT_EQ(popedSum, numberOfGeneratedNumbers * (numberOfGeneratedNumbers - 1) / 2);
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(ShardedStack, PushAndPopWithMultipleThreads)
+{
+	ThreadSafeStructs::ShardedStack<int> container(4);
+	std::atomic<int64_t> pushedSum(0);
+	std::atomic<int64_t> popedSum(0);
+	const auto numberOfGeneratedNumbers = 10000;
+	const auto numberOfTestingThreads = 8;
+
+	auto pushAndPopFunction = [numberOfGeneratedNumbers, &container, &pushedSum, &popedSum]()
+		{
+			for (int numbersGenerated = 0; numbersGenerated < numberOfGeneratedNumbers; ++numbersGenerated)
+			{
+				container.Push(numbersGenerated);
+				pushedSum += numbersGenerated;
+				// the scan over shards is not atomic, a pop may miss an item pushed behind it
+				int item;
+				if (container.TryPop(item))
+				{
+					popedSum += item;
+				}
+			}
+		};
+
+	TestThreadsManager<decltype(pushAndPopFunction), int> threadsManger;
+	for (int threadToTest = 0; threadToTest < numberOfTestingThreads; ++threadToTest)
+	{
+		threadsManger.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<decltype(pushAndPopFunction), int>>(
+				pushAndPopFunction,
+				threadsManger.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	threadsManger.WaitThreadFinished();
+
+	ASSERT_EQ(threadsManger.GetWhaitForThreadsReadyExceptionsCount(), 0);
+	ASSERT_EQ(threadsManger.GetThreadsProcessedExceptionsCount(), 0);
+
+	int item;
+	while (container.TryPop(item))
+	{
+		popedSum += item;
+	}
+	EXPECT_EQ(pushedSum.load(), popedSum.load());
+	EXPECT_TRUE(container.Empty());
+}
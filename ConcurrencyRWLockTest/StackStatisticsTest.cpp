@@ -0,0 +1,257 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "StackStatistics.h"
+
+namespace
+{
+	using InstrumentedStack = ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::InstrumentedLock<ThreadSafeStructs::DefaultLockPolicy>>;
+
+	static_assert(ThreadSafeStructs::IsSharedLockable<ThreadSafeStructs::InstrumentedLock<ThreadSafeStructs::DefaultLockPolicy>>::value,
+		"Instrumented reader-writer lock keeps its shared lock.");
+	static_assert(!ThreadSafeStructs::IsSharedLockable<ThreadSafeStructs::InstrumentedLock<std::mutex>>::value,
+		"Instrumented exclusive lock does not get a shared lock.");
+
+	// Only the first move of a slow item sleeps, which keeps the stack locked during its Push.
+	struct SlowMovedItem
+	{
+		explicit SlowMovedItem(const bool isSlow = false) noexcept
+			: isSlow(isSlow)
+		{
+		}
+
+		SlowMovedItem(SlowMovedItem&& other) noexcept
+			: isSlow(false)
+		{
+			if (other.isSlow)
+			{
+				other.isSlow = false;
+				slowMoveStarted = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			}
+		}
+
+		SlowMovedItem& operator=(SlowMovedItem&& other) noexcept
+		{
+			isSlow = false;
+			other.isSlow = false;
+			return *this;
+		}
+
+		bool isSlow;
+		static inline std::atomic<bool> slowMoveStarted = false;
+	};
+
+	// The first try_lock after every unlock fails, as if another thread held the lock just then.
+	class BusyOnFirstTryLock
+	{
+	public:
+		void lock()
+		{
+			mutex.lock();
+		}
+
+		bool try_lock()
+		{
+			if (isNextTryBusy)
+			{
+				isNextTryBusy = false;
+				return false;
+			}
+			return mutex.try_lock();
+		}
+
+		void unlock()
+		{
+			isNextTryBusy = true;
+			mutex.unlock();
+		}
+
+	private:
+		std::mutex mutex;
+		bool isNextTryBusy = true;
+	};
+
+	template<typename Predicate>
+	void WaitFor(Predicate&& predicate)
+	{
+		while (!predicate())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+TEST(StackStatistics, NotInstrumentedStackReportsZeros_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	container.Push(1).Push(2);
+	container.TryPop();
+
+	const auto stats = container.Stats();
+	for (const auto counter : stats.counters)
+	{
+		EXPECT_EQ(counter, 0u);
+	}
+	EXPECT_EQ(stats.peakSize, 0u);
+}
+
+TEST(StackStatistics, CountsAcquisitionsAndPeakSize_OneThread)
+{
+	InstrumentedStack container;
+	container.Push(1).Push(2).Push(3);
+	container.TryPop();
+	container.Push(4);
+	EXPECT_EQ(container.Peek(), 4);
+
+	const auto stats = container.Stats();
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::LOCK_ACQUISITIONS], 6u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::CONTENDED_ACQUISITIONS], 0u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::WAIT_BLOCKS], 0u);
+	EXPECT_EQ(stats.peakSize, 3u);
+}
+
+TEST(StackStatistics, ContendedLockRecordsWaitAndHoldTime)
+{
+	ThreadSafeStructs::InstrumentedLock<std::mutex> lock;
+	lock.lock();
+	auto waiterDone = std::async(std::launch::async, [&lock]()
+		{
+			lock.lock();
+			lock.unlock();
+		});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	lock.unlock();
+	waiterDone.get();
+
+	const auto stats = lock.Statistics().Snapshot();
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::LOCK_ACQUISITIONS], 2u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::CONTENDED_ACQUISITIONS], 1u);
+	EXPECT_GT(stats.counters[ThreadSafeStructs::LOCK_WAIT_NANOSECONDS], 0u);
+	EXPECT_GE(stats.counters[ThreadSafeStructs::LOCK_HOLD_NANOSECONDS], 20000000u);
+}
+
+TEST(StackStatistics, FailedTryLockCountsAsContended_OneThread)
+{
+	// by the time the elimination attempt gives up the lock is free, the acquisition is still contended
+	ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::InstrumentedLock<BusyOnFirstTryLock>> container;
+	container.Push(1);
+	EXPECT_EQ(container.TryPop(), 1);
+
+	const auto stats = container.Stats();
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::LOCK_ACQUISITIONS], 2u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::CONTENDED_ACQUISITIONS], 2u);
+	EXPECT_GT(stats.counters[ThreadSafeStructs::LOCK_WAIT_NANOSECONDS], 0u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::ELIMINATED_OPERATIONS], 0u);
+}
+
+TEST(StackStatistics, ContendedPushAndTryPopRecordWaitTime)
+{
+	ThreadSafeStructs::RWLockStack<SlowMovedItem, ThreadSafeStructs::InstrumentedLock<ThreadSafeStructs::DefaultLockPolicy>> container;
+	auto slowPushDone = std::async(std::launch::async, [&container]() { container.Push(SlowMovedItem(true)); });
+	WaitFor([]() { return SlowMovedItem::slowMoveStarted.load(); });
+
+	// both find the lock held, they either meet in the elimination array or wait for the lock
+	auto pushDone = std::async(std::launch::async, [&container]() { container.Push(SlowMovedItem()); });
+	auto popDone = std::async(std::launch::async, [&container]()
+		{
+			SlowMovedItem item;
+			container.TryPop(item);
+		});
+	slowPushDone.get();
+	pushDone.get();
+	popDone.get();
+
+	const auto stats = container.Stats();
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::CONTENDED_ACQUISITIONS] + stats.counters[ThreadSafeStructs::ELIMINATED_OPERATIONS], 2u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::ELIMINATED_OPERATIONS] % 2, 0u);
+	EXPECT_GT(stats.counters[ThreadSafeStructs::LOCK_WAIT_NANOSECONDS], 0u);
+}
+
+TEST(StackStatistics, WhaitAndPopRecordsBlockWakeUpAndNotify)
+{
+	InstrumentedStack container;
+	auto popped = std::async(std::launch::async, [&container]() { return container.WhaitAndPop(); });
+	WaitFor([&container]() { return container.Stats().counters[ThreadSafeStructs::WAIT_BLOCKS] == 1; });
+
+	container.Push(7);
+	EXPECT_EQ(popped.get(), 7);
+
+	const auto stats = container.Stats();
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::WAIT_BLOCKS], 1u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::WAKE_UPS], 1u);
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::NOTIFIES], 1u);
+}
+
+TEST(StackStatistics, PushWakesOneConsumerOverBothWaitKinds)
+{
+	InstrumentedStack container;
+	auto poppedByCondVar = std::async(std::launch::async, [&container]() { return container.WhaitAndPop(); });
+	auto poppedByAtomicWait = std::async(std::launch::async, [&container]() { return container.AtomicWaitAndPop(); });
+	WaitFor([&container]() { return container.Stats().counters[ThreadSafeStructs::WAIT_BLOCKS] == 2; });
+
+	container.Push(1);
+	EXPECT_EQ(container.Stats().counters[ThreadSafeStructs::NOTIFIES], 1u);
+	container.Push(2);
+	EXPECT_EQ(poppedByCondVar.get() + poppedByAtomicWait.get(), 3);
+	EXPECT_EQ(container.Stats().counters[ThreadSafeStructs::NOTIFIES], 2u);
+}
+
+TEST(StackStatistics, CountersAddUpOverThreads)
+{
+	const auto numberOfThreads = 4;
+	const auto numberOfItems = 1000;
+	InstrumentedStack container;
+
+	std::list<std::future<void>> threadsDone;
+	for (int thread = 0; thread < numberOfThreads; ++thread)
+	{
+		threadsDone.push_back(std::async(std::launch::async, [&container, numberOfItems]()
+			{
+				for (int number = 0; number < numberOfItems; ++number)
+				{
+					container.Emplace(number);
+				}
+			}));
+	}
+	for (auto& threadDone : threadsDone)
+	{
+		threadDone.get();
+	}
+
+	const auto stats = container.Stats();
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::LOCK_ACQUISITIONS], static_cast<uint64_t>(numberOfThreads * numberOfItems));
+	EXPECT_EQ(stats.peakSize, static_cast<uint64_t>(numberOfThreads * numberOfItems));
+}
+
+TEST(StackStatistics, RendersPrometheusAndJson)
+{
+	ThreadSafeStructs::StackStatsSnapshot stats;
+	stats.counters[ThreadSafeStructs::LOCK_ACQUISITIONS] = 12;
+	stats.counters[ThreadSafeStructs::NOTIFIES] = 3;
+	stats.peakSize = 5;
+
+	const auto prometheus = stats.ToPrometheus("jobs");
+	EXPECT_NE(prometheus.find("# TYPE jobs_lock_acquisitions_total counter\njobs_lock_acquisitions_total 12\n"), std::string::npos);
+	EXPECT_NE(prometheus.find("jobs_notifies_total 3\n"), std::string::npos);
+	EXPECT_NE(prometheus.find("# TYPE jobs_peak_size gauge\njobs_peak_size 5\n"), std::string::npos);
+
+	EXPECT_EQ(stats.ToJson(), "{\"lockAcquisitions\":12,\"contendedAcquisitions\":0,\"lockWaitNanoseconds\":0,"
+		"\"lockHoldNanoseconds\":0,\"waitBlocks\":0,\"wakeUps\":0,\"notifies\":3,\"eliminatedOperations\":0,\"peakSize\":5}");
+}
+
+TEST(StackStatistics, WritesToFile)
+{
+	ThreadSafeStructs::StackStatsSnapshot stats;
+	stats.peakSize = 9;
+	const std::string path = "stack_statistics_test.json";
+
+	stats.WriteToFile(path, ThreadSafeStructs::StackStatsSnapshot::Format::JSON);
+	std::ifstream file(path);
+	const std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	std::remove(path.c_str());
+	EXPECT_EQ(written, stats.ToJson());
+
+	EXPECT_THROW(stats.WriteToFile("missing_directory/stats.txt", ThreadSafeStructs::StackStatsSnapshot::Format::PROMETHEUS),
+		ThreadSafeStructs::ThreadSafetyException);
+}
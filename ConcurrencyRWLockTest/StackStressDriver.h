@@ -0,0 +1,227 @@
+#pragma once
+#include "RWLStackTestUtils.h"
+#include "SeparatedThreadCallbackExecutor.h"
+#include "LatencyHistogram.h"
+
+struct StressOptions
+{
+	uint32_t producersCount = 1;
+	uint32_t consumersCount = 1;
+	// Threads run for duration, or for operationsPerThread operations each when duration is zero.
+	std::chrono::milliseconds duration{ 0 };
+	uint64_t operationsPerThread = 100000;
+	// thread i runs on CPU i modulo the CPU count
+	bool pinThreads = true;
+	// Run() writes the report here when set
+	std::ostream* reportOutput = nullptr;
+};
+
+struct StressThreadReport
+{
+	std::string name;
+	uint64_t operations = 0;
+	// successful TryPop calls of consumers, the rest found the stack empty
+	uint64_t popedItems = 0;
+	std::chrono::nanoseconds elapsed{ 0 };
+	LatencyHistogram latencies;
+	// -1 when pinning was off or failed
+	int32_t pinnedCpu = -1;
+
+	double GetOperationsPerSecond() const noexcept;
+	std::string ToString() const;
+};
+
+struct StressReport
+{
+	std::vector<StressThreadReport> threads;
+	int32_t failedThreadsCount = 0;
+	// threads which were to be pinned but the affinity call failed
+	int32_t unpinnedThreadsCount = 0;
+
+	// Sums threads whose name starts with namePrefix, elapsed is the longest of them.
+	StressThreadReport Aggregate(const std::string& name, const std::string& namePrefix = "") const;
+	// One line per thread, then producers, consumers and all threads together.
+	std::string ToString() const;
+};
+
+bool PinCurrentThreadToCpu(const uint32_t cpu) noexcept;
+
+// Load driver for stack stress runs. Producers Push and consumers TryPop in a loop, all of them
+// released at once by the TestThreadsManager start barrier, and every operation's latency lands
+// in the histogram of its thread.
+template<typename T, typename Stack = ThreadSafeStructs::RWLockStack<T>>
+class StackStressDriver
+{
+public:
+	StackStressDriver(Stack& stack, const StressOptions& options);
+
+	StressReport Run();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void RunThread(const uint32_t threadIndex, StressThreadReport& report);
+
+	Stack& stack;
+	const StressOptions options;
+};
+
+inline double StressThreadReport::GetOperationsPerSecond() const noexcept
+{
+	if (elapsed.count() == 0)
+	{
+		return 0.0;
+	}
+	return static_cast<double>(operations) / std::chrono::duration<double>(elapsed).count();
+}
+
+inline std::string StressThreadReport::ToString() const
+{
+	std::ostringstream text;
+	text << name << ": " << operations << " ops, " << static_cast<uint64_t>(GetOperationsPerSecond()) << " ops/s";
+	if (pinnedCpu >= 0)
+	{
+		text << ", cpu " << pinnedCpu;
+	}
+	if (popedItems > 0)
+	{
+		text << ", " << popedItems << " poped";
+	}
+	text << ", p50 " << latencies.ValueAtPercentile(50.0)
+		<< " ns, p99 " << latencies.ValueAtPercentile(99.0)
+		<< " ns, p99.9 " << latencies.ValueAtPercentile(99.9)
+		<< " ns, max " << latencies.Max() << " ns";
+	return text.str();
+}
+
+inline StressThreadReport StressReport::Aggregate(const std::string& name, const std::string& namePrefix) const
+{
+	StressThreadReport aggregate;
+	aggregate.name = name;
+	for (const auto& thread : threads)
+	{
+		if (thread.name.compare(0, namePrefix.size(), namePrefix) != 0)
+		{
+			continue;
+		}
+		aggregate.operations += thread.operations;
+		aggregate.popedItems += thread.popedItems;
+		aggregate.elapsed = std::max(aggregate.elapsed, thread.elapsed);
+		aggregate.latencies.Merge(thread.latencies);
+	}
+	return aggregate;
+}
+
+inline std::string StressReport::ToString() const
+{
+	std::ostringstream text;
+	for (const auto& thread : threads)
+	{
+		text << thread.ToString() << "\n";
+	}
+	text << Aggregate("producers", "producer").ToString() << "\n";
+	text << Aggregate("consumers", "consumer").ToString() << "\n";
+	text << Aggregate("all").ToString() << "\n";
+	if (failedThreadsCount > 0)
+	{
+		text << failedThreadsCount << " threads failed\n";
+	}
+	if (unpinnedThreadsCount > 0)
+	{
+		text << unpinnedThreadsCount << " threads could not be pinned\n";
+	}
+	return text.str();
+}
+
+inline bool PinCurrentThreadToCpu(const uint32_t cpu) noexcept
+{
+#if defined(_WIN32)
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (cpu % (sizeof(DWORD_PTR) * 8))) != 0;
+#elif defined(__linux__)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu % CPU_SETSIZE, &cpus);
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+template<typename T, typename Stack>
+StackStressDriver<T, Stack>::StackStressDriver(Stack& stack, const StressOptions& options)
+	: stack(stack),
+	options(options)
+{
+}
+
+template<typename T, typename Stack>
+StressReport StackStressDriver<T, Stack>::Run()
+{
+	StressReport report;
+	report.threads.resize(options.producersCount + options.consumersCount);
+
+	using ThreadFunction = std::function<void()>;
+	TestThreadsManager<ThreadFunction, void> threadsManager;
+	for (uint32_t threadIndex = 0; threadIndex < report.threads.size(); ++threadIndex)
+	{
+		auto& threadReport = report.threads[threadIndex];
+		threadsManager.AddThreadExecutor(
+			std::make_unique<SeparatedThreadCallbackExecutor<ThreadFunction, void>>(
+				[this, threadIndex, &threadReport]() { RunThread(threadIndex, threadReport); },
+				threadsManager.GetMainThreadReadyFuture()
+			)
+		);
+	}
+	threadsManager.WaitThreadFinished();
+
+	report.failedThreadsCount = threadsManager.GetThreadsProcessedExceptionsCount();
+	if (options.pinThreads)
+	{
+		report.unpinnedThreadsCount = static_cast<int32_t>(std::count_if(report.threads.begin(), report.threads.end(),
+			[](const StressThreadReport& thread) { return thread.pinnedCpu < 0; }));
+	}
+	if (options.reportOutput != nullptr)
+	{
+		*options.reportOutput << report.ToString();
+	}
+	return report;
+}
+
+template<typename T, typename Stack>
+void StackStressDriver<T, Stack>::RunThread(const uint32_t threadIndex, StressThreadReport& report)
+{
+	const auto isProducer = threadIndex < options.producersCount;
+	report.name = (isProducer ? "producer " : "consumer ") + std::to_string(threadIndex);
+	if (options.pinThreads)
+	{
+		const auto cpu = threadIndex % std::max(1u, std::thread::hardware_concurrency());
+		if (PinCurrentThreadToCpu(cpu))
+		{
+			report.pinnedCpu = static_cast<int32_t>(cpu);
+		}
+	}
+
+	T item{};
+	const auto runForDuration = options.duration.count() > 0;
+	const auto start = Clock::now();
+	const auto deadline = start + options.duration;
+	// one clock read per operation, its end is the start of the next one
+	auto operationStart = start;
+	while (runForDuration ? operationStart < deadline : report.operations < options.operationsPerThread)
+	{
+		if (isProducer)
+		{
+			stack.Push(item);
+		}
+		else if (stack.TryPop(item))
+		{
+			++report.popedItems;
+		}
+		const auto operationEnd = Clock::now();
+		report.latencies.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(operationEnd - operationStart).count()));
+		++report.operations;
+		operationStart = operationEnd;
+	}
+	report.elapsed = operationStart - start;
+}
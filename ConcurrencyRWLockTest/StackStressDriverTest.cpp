@@ -0,0 +1,92 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "StackStressDriver.h"
+
+TEST(LatencyHistogram, SmallValuesAreExact_OneThread)
+{
+	LatencyHistogram histogram;
+	for (uint64_t value = 1; value <= 100; ++value)
+	{
+		histogram.Record(value);
+	}
+
+	EXPECT_EQ(histogram.Count(), 100u);
+	EXPECT_EQ(histogram.ValueAtPercentile(50.0), 50u);
+	EXPECT_EQ(histogram.ValueAtPercentile(99.0), 99u);
+	EXPECT_EQ(histogram.ValueAtPercentile(100.0), 100u);
+	EXPECT_EQ(histogram.Max(), 100u);
+	EXPECT_EQ(LatencyHistogram().ValueAtPercentile(99.0), 0u);
+}
+
+TEST(LatencyHistogram, LargeValuesStayWithinRelativeError_OneThread)
+{
+	LatencyHistogram histogram;
+	const std::vector<uint64_t> values = { 1000, 123456, 9876543, 4000000000ull, 1ull << 50 };
+	for (const auto value : values)
+	{
+		LatencyHistogram single;
+		single.Record(value);
+		single.Record(std::numeric_limits<uint64_t>::max());
+		const auto reported = single.ValueAtPercentile(50.0);
+		EXPECT_GE(reported, value);
+		EXPECT_LE(reported - value, value / 64);
+		histogram.Merge(single);
+	}
+
+	EXPECT_EQ(histogram.Count(), 2 * values.size());
+	EXPECT_EQ(histogram.Max(), std::numeric_limits<uint64_t>::max());
+}
+
+TEST(StackStressDriver, FixedOperationsCountReportsEveryThread)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	StressOptions options;
+	options.producersCount = 2;
+	options.consumersCount = 2;
+	options.operationsPerThread = 5000;
+	std::ostringstream reportOutput;
+	options.reportOutput = &reportOutput;
+
+	const auto report = StackStressDriver<int>(container, options).Run();
+
+	ASSERT_EQ(report.failedThreadsCount, 0);
+	ASSERT_EQ(report.threads.size(), 4u);
+	int32_t unpinnedThreadsCount = 0;
+	for (const auto& thread : report.threads)
+	{
+		EXPECT_EQ(thread.operations, options.operationsPerThread);
+		EXPECT_EQ(thread.latencies.Count(), options.operationsPerThread);
+		unpinnedThreadsCount += thread.pinnedCpu < 0 ? 1 : 0;
+	}
+	EXPECT_EQ(report.unpinnedThreadsCount, unpinnedThreadsCount);
+	EXPECT_EQ(reportOutput.str(), report.ToString());
+	EXPECT_NE(reportOutput.str().find("\nproducers: 10000 ops, "), std::string::npos);
+	EXPECT_NE(reportOutput.str().find("\nall: 20000 ops, "), std::string::npos);
+	const auto consumers = report.Aggregate("consumers", "consumer");
+	EXPECT_EQ(report.Aggregate("producers", "producer").operations, 2 * options.operationsPerThread);
+	EXPECT_EQ(container.Size(), 2 * options.operationsPerThread - consumers.popedItems);
+	EXPECT_EQ(report.Aggregate("all").latencies.Count(), 4 * options.operationsPerThread);
+}
+
+TEST(StackStressDriver, DurationRunStopsEveryThreadAfterDuration)
+{
+	ThreadSafeStructs::RWLockStack<int> container;
+	StressOptions options;
+	options.producersCount = 2;
+	options.consumersCount = 2;
+	options.duration = std::chrono::milliseconds(50);
+	options.pinThreads = false;
+	options.reportOutput = &std::cout;
+
+	const auto report = StackStressDriver<int>(container, options).Run();
+
+	ASSERT_EQ(report.failedThreadsCount, 0);
+	for (const auto& thread : report.threads)
+	{
+		EXPECT_GT(thread.operations, 0u);
+		EXPECT_GE(thread.elapsed, options.duration);
+		EXPECT_EQ(thread.pinnedCpu, -1);
+	}
+	EXPECT_EQ(report.unpinnedThreadsCount, 0);
+	EXPECT_EQ(report.Aggregate("all").latencies.Count(), report.Aggregate("all").operations);
+}
@@ -0,0 +1,185 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "StackTrace.h"
+
+namespace
+{
+	using TracedStack = ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::TracedLock<ThreadSafeStructs::DefaultLockPolicy>>;
+
+	size_t CountOccurrences(const std::string& text, const std::string& pattern)
+	{
+		size_t count = 0;
+		for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + pattern.size()))
+		{
+			++count;
+		}
+		return count;
+	}
+}
+
+TEST(StackTrace, TracedStackRecordsLockSpansAndOperations_OneThread)
+{
+	auto& tracer = ThreadSafeStructs::Tracer::Instance();
+	tracer.Clear();
+	TracedStack container;
+	container.Push(1).Push(2);
+	container.TryPop();
+	EXPECT_EQ(container.Peek(), 1);
+
+	const auto trace = tracer.ExportChromeTrace();
+	EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0u);
+	EXPECT_EQ(trace.substr(trace.size() - 2), "]}");
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"Push\""), 2u);
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"Pop\""), 1u);
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"lock held\""), 3u);
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"shared lock held\""), 1u);
+}
+
+TEST(StackTrace, NotTracedStackRecordsNothing_OneThread)
+{
+	auto& tracer = ThreadSafeStructs::Tracer::Instance();
+	tracer.Clear();
+	ThreadSafeStructs::RWLockStack<int> container;
+	container.Push(1);
+	container.TryPop();
+
+	EXPECT_EQ(tracer.ExportChromeTrace(), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}");
+}
+
+TEST(StackTrace, WhaitAndPopRecordsWaitSpan)
+{
+	auto& tracer = ThreadSafeStructs::Tracer::Instance();
+	tracer.Clear();
+	TracedStack container;
+	auto popped = std::async(std::launch::async, [&container]() { return container.WhaitAndPop(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	container.Push(5);
+	EXPECT_EQ(popped.get(), 5);
+
+	const auto trace = tracer.ExportChromeTrace();
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"wait for items\""), 1u);
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"Pop\""), 1u);
+}
+
+TEST(StackTrace, EveryPushAndPopIsTracedUnderContention)
+{
+	auto& tracer = ThreadSafeStructs::Tracer::Instance();
+	tracer.Clear();
+	const auto numberOfThreads = 4;
+	// threads which do not overlap hand their trace buffer on, all events have to fit in one
+	const auto numberOfItems = 150;
+	TracedStack container;
+	std::atomic<int> popedCount = 0;
+
+	std::list<std::future<void>> threadsDone;
+	for (int thread = 0; thread < numberOfThreads; ++thread)
+	{
+		threadsDone.push_back(std::async(std::launch::async, [&container, &popedCount]()
+			{
+				int item = 0;
+				for (int number = 0; number < numberOfItems; ++number)
+				{
+					// some of these meet in the elimination array and never take the lock
+					container.Push(number);
+					popedCount += container.TryPop(item) ? 1 : 0;
+				}
+			}));
+	}
+	for (auto& threadDone : threadsDone)
+	{
+		threadDone.get();
+	}
+
+	const auto trace = tracer.ExportChromeTrace();
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"Push\""), static_cast<size_t>(numberOfThreads * numberOfItems));
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"Pop\""), static_cast<size_t>(popedCount.load()));
+	tracer.Clear();
+}
+
+TEST(StackTrace, RingBufferKeepsNewestEvents_OneThread)
+{
+	auto& tracer = ThreadSafeStructs::Tracer::Instance();
+	tracer.Clear();
+	const auto overflow = 100;
+	for (uint32_t event = 0; event < ThreadSafeStructs::TraceBuffer::TRACE_BUFFER_CAPACITY + overflow; ++event)
+	{
+		tracer.Record(ThreadSafeStructs::PUSH_EVENT, &tracer, event);
+	}
+
+	const auto trace = tracer.ExportChromeTrace();
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"Push\""), ThreadSafeStructs::TraceBuffer::TRACE_BUFFER_CAPACITY);
+	EXPECT_EQ(CountOccurrences(trace, "\"value\":" + std::to_string(overflow - 1) + "}"), 0u);
+	EXPECT_EQ(CountOccurrences(trace, "\"value\":" + std::to_string(overflow) + "}"), 1u);
+	tracer.Clear();
+}
+
+TEST(StackTrace, WritesToFile)
+{
+	auto& tracer = ThreadSafeStructs::Tracer::Instance();
+	tracer.Clear();
+	TracedStack container;
+	container.Push(1);
+	const std::string path = "stack_trace_test.json";
+
+	tracer.WriteChromeTrace(path);
+	std::ifstream file(path);
+	const std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	std::remove(path.c_str());
+	// time stamps are converted with the calibration at export time, so compare the events only
+	EXPECT_EQ(written.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0u);
+	EXPECT_EQ(CountOccurrences(written, "\"name\":\"Push\""), 1u);
+	EXPECT_EQ(CountOccurrences(written, "\"name\":\"lock held\""), 1u);
+	EXPECT_THROW(tracer.WriteChromeTrace("missing_directory/trace.json"), ThreadSafeStructs::ThreadSafetyException);
+}
+
+TEST(StackTrace, ReadWhileRecordingReturnsOnlyCompleteEvents)
+{
+	ThreadSafeStructs::TraceBuffer buffer;
+	buffer.TryAcquire(1);
+	const uint32_t numberOfEvents = 1000000;
+	std::atomic<bool> isRecording = true;
+	auto recorder = std::async(std::launch::async, [&buffer, &isRecording]()
+		{
+			for (uint32_t event = 0; event < numberOfEvents; ++event)
+			{
+				buffer.Record(ThreadSafeStructs::PUSH_EVENT, reinterpret_cast<const void*>(static_cast<uintptr_t>(event)), event);
+			}
+			isRecording = false;
+		});
+
+	std::vector<ThreadSafeStructs::TraceBuffer::Event> events;
+	do
+	{
+		events.clear();
+		buffer.ReadEvents(events);
+		ASSERT_LE(events.size(), ThreadSafeStructs::TraceBuffer::TRACE_BUFFER_CAPACITY);
+		for (size_t index = 0; index < events.size(); ++index)
+		{
+			// torn slots would mix the fields of two events
+			ASSERT_EQ(events[index].object, events[index].value);
+			ASSERT_EQ(events[index].threadNumber, 1u);
+			if (index > 0)
+			{
+				ASSERT_GT(events[index].value, events[index - 1].value);
+			}
+		}
+	} while (isRecording);
+	recorder.get();
+
+	events.clear();
+	buffer.ReadEvents(events);
+	ASSERT_EQ(events.size(), ThreadSafeStructs::TraceBuffer::TRACE_BUFFER_CAPACITY);
+	EXPECT_EQ(events.back().value, numberOfEvents - 1);
+}
+
+TEST(StackTrace, TracedInstrumentedLockKeepsStatistics_OneThread)
+{
+	ThreadSafeStructs::RWLockStack<int, ThreadSafeStructs::TracedLock<ThreadSafeStructs::InstrumentedLock<std::mutex>>> container;
+	container.Push(1).Push(2);
+	ThreadSafeStructs::Tracer::Instance().Clear();
+
+	const auto stats = container.Stats();
+	EXPECT_EQ(stats.counters[ThreadSafeStructs::LOCK_ACQUISITIONS], 2u);
+	EXPECT_EQ(stats.peakSize, 2u);
+}
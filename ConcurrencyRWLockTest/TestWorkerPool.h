@@ -0,0 +1,105 @@
+#pragma once
+
+// Threads for running many short test rounds back to back. Workers are started once and wait on
+// a reusable start gate, every round releases them all at once and waits on the finish gate
+// until the last one is done, so a round costs two barrier passes instead of a thread launch.
+class TestWorkerPool
+{
+public:
+	using RoundFunction = std::function<void(const uint32_t threadIndex)>;
+
+	explicit TestWorkerPool(const uint32_t threadsCount);
+	TestWorkerPool(const TestWorkerPool&) = delete;
+	TestWorkerPool& operator=(const TestWorkerPool&) = delete;
+	~TestWorkerPool();
+
+	// Runs roundFunction on every worker and returns when all of them finished it. An exception
+	// thrown by a worker is counted and does not stop the pool.
+	void RunRound(RoundFunction roundFunction);
+	void RunRounds(const uint32_t roundsCount, const RoundFunction& roundFunction);
+
+	uint32_t GetThreadsCount() const noexcept;
+	int32_t GetThreadsProcessedExceptionsCount() const noexcept;
+
+private:
+	void WorkerLoop(const uint32_t threadIndex);
+
+	// written by the main thread between rounds, the start gate publishes it to the workers
+	RoundFunction roundFunction;
+	bool stopRequested;
+	std::barrier<> startGate;
+	std::barrier<> finishGate;
+	std::atomic<int32_t> threadsProcessedExceptionsCount;
+	std::vector<std::thread> workers;
+};
+
+inline TestWorkerPool::TestWorkerPool(const uint32_t threadsCount)
+	: stopRequested(false),
+	startGate(static_cast<std::ptrdiff_t>(threadsCount) + 1),
+	finishGate(static_cast<std::ptrdiff_t>(threadsCount) + 1),
+	threadsProcessedExceptionsCount(0)
+{
+	workers.reserve(threadsCount);
+	for (uint32_t threadIndex = 0; threadIndex < threadsCount; ++threadIndex)
+	{
+		workers.emplace_back(&TestWorkerPool::WorkerLoop, this, threadIndex);
+	}
+}
+
+inline TestWorkerPool::~TestWorkerPool()
+{
+	stopRequested = true;
+	startGate.arrive_and_wait();
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+inline void TestWorkerPool::RunRound(RoundFunction roundFunction)
+{
+	this->roundFunction = std::move(roundFunction);
+	startGate.arrive_and_wait();
+	finishGate.arrive_and_wait();
+}
+
+inline void TestWorkerPool::RunRounds(const uint32_t roundsCount, const RoundFunction& roundFunction)
+{
+	this->roundFunction = roundFunction;
+	for (uint32_t round = 0; round < roundsCount; ++round)
+	{
+		startGate.arrive_and_wait();
+		finishGate.arrive_and_wait();
+	}
+}
+
+inline uint32_t TestWorkerPool::GetThreadsCount() const noexcept
+{
+	return static_cast<uint32_t>(workers.size());
+}
+
+inline int32_t TestWorkerPool::GetThreadsProcessedExceptionsCount() const noexcept
+{
+	return threadsProcessedExceptionsCount.load();
+}
+
+inline void TestWorkerPool::WorkerLoop(const uint32_t threadIndex)
+{
+	while (true)
+	{
+		startGate.arrive_and_wait();
+		if (stopRequested)
+		{
+			return;
+		}
+		try
+		{
+			roundFunction(threadIndex);
+		}
+		catch (...)
+		{
+			++threadsProcessedExceptionsCount;
+		}
+		finishGate.arrive_and_wait();
+	}
+}
@@ -0,0 +1,48 @@
+#include "stdfx.h"
+#include "RWLockStack.h"
+#include "RWLStackTestUtils.h"
+#include "TestWorkerPool.h"
+
+TEST(TestWorkerPool, ManyRoundsOfThreadIndexPushes)
+{
+	const auto numberOfTestingThreads = 4;
+	const auto numberOfGeneratedNumbers = 10;
+	const auto numberOfRounds = 2000;
+	ThreadSafeStructs::RWLockStack<int> container;
+	TestWorkerPool workerPool(numberOfTestingThreads);
+
+	for (int round = 0; round < numberOfRounds; ++round)
+	{
+		workerPool.RunRound([numberOfGeneratedNumbers, &container](const uint32_t threadIndex)
+			{
+				ThreadIndexParamCheckCallback(static_cast<int32_t>(threadIndex), numberOfGeneratedNumbers, container)();
+			});
+
+		std::vector<int> pushedPerThread(numberOfTestingThreads, 0);
+		int item;
+		while (container.TryPop(item))
+		{
+			++pushedPerThread[item];
+		}
+		ASSERT_EQ(pushedPerThread, std::vector<int>(numberOfTestingThreads, numberOfGeneratedNumbers)) << "round " << round;
+	}
+	EXPECT_EQ(workerPool.GetThreadsProcessedExceptionsCount(), 0);
+}
+
+TEST(TestWorkerPool, ThrowingRoundIsCountedAndPoolGoesOn)
+{
+	TestWorkerPool workerPool(3);
+	std::atomic<int32_t> finishedRounds(0);
+
+	workerPool.RunRound([](const uint32_t threadIndex)
+		{
+			if (threadIndex == 1)
+			{
+				throw ThreadSafeStructs::ThreadSafetyException("Round failed.");
+			}
+		});
+	workerPool.RunRounds(100, [&finishedRounds](const uint32_t) { ++finishedRounds; });
+
+	EXPECT_EQ(workerPool.GetThreadsProcessedExceptionsCount(), 1);
+	EXPECT_EQ(finishedRounds.load(), 300);
+}
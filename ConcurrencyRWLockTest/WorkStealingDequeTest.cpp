@@ -0,0 +1,90 @@
+#include "stdfx.h"
+#include "WorkStealingDeque.h"
+
+TEST(WorkStealingDeque, CreateContainer_Empty)
+{
+	ThreadSafeStructs::WorkStealingDeque<int> container;
+	int item;
+
+	EXPECT_TRUE(container.Empty());
+	EXPECT_FALSE(container.Pop(item));
+	EXPECT_FALSE(container.Steal(item));
+}
+
+TEST(WorkStealingDeque, OwnerPopsNewestAndThiefStealsOldest_OneThread)
+{
+	ThreadSafeStructs::WorkStealingDeque<int> container(2);
+	for (int number = 0; number < 100; ++number)
+	{
+		container.Push(number);
+	}
+	ASSERT_EQ(container.Size(), 100);
+
+	int item;
+	ASSERT_TRUE(container.Pop(item));
+	EXPECT_EQ(item, 99);
+	ASSERT_TRUE(container.Steal(item));
+	EXPECT_EQ(item, 0);
+	ASSERT_TRUE(container.Steal(item));
+	EXPECT_EQ(item, 1);
+	EXPECT_EQ(container.Size(), 97);
+
+	for (int number = 98; number >= 2; --number)
+	{
+		ASSERT_TRUE(container.Pop(item));
+		ASSERT_EQ(item, number);
+	}
+	EXPECT_FALSE(container.Pop(item));
+	EXPECT_TRUE(container.Empty());
+}
+
+TEST(WorkStealingDeque, OwnerAndThievesTakeEveryItemExactlyOnce)
+{
+	ThreadSafeStructs::WorkStealingDeque<int> container(4);
+	const auto numberOfGeneratedNumbers = 100000;
+	const auto numberOfThieves = 4;
+	std::vector<std::atomic<int>> takenCounts(numberOfGeneratedNumbers);
+	std::atomic<bool> ownerFinished(false);
+
+	auto stealFunction = [&container, &takenCounts, &ownerFinished]()
+		{
+			int item;
+			while (!ownerFinished.load() || !container.Empty())
+			{
+				if (container.Steal(item))
+				{
+					++takenCounts[item];
+				}
+			}
+		};
+
+	std::list<std::future<void>> thievesDone;
+	for (int thief = 0; thief < numberOfThieves; ++thief)
+	{
+		thievesDone.push_back(std::async(std::launch::async, stealFunction));
+	}
+
+	int item;
+	for (int number = 0; number < numberOfGeneratedNumbers; ++number)
+	{
+		container.Push(number);
+		if (number % 3 == 0 && container.Pop(item))
+		{
+			++takenCounts[item];
+		}
+	}
+	while (container.Pop(item))
+	{
+		++takenCounts[item];
+	}
+	ownerFinished.store(true);
+	for (auto& thiefDone : thievesDone)
+	{
+		thiefDone.get();
+	}
+
+	for (int number = 0; number < numberOfGeneratedNumbers; ++number)
+	{
+		ASSERT_EQ(takenCounts[number].load(), 1) << "item " << number;
+	}
+}
@@ -3,9 +3,42 @@
 #include <random>
 #include <future>
 #include <list>
+#include <deque>
+#include <string>
 
 #include <stack>
 #include <vector>
 #include <stdexcept>
 #include <condition_variable>
-#include "boost/thread/shared_mutex.hpp"
\ No newline at end of file
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <limits>
+#include <chrono>
+#include <memory>
+#include <type_traits>
+#include <optional>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <coroutine>
+#include <concepts>
+#include <numeric>
+#include <iostream>
+#include <bit>
+#include <cmath>
+#include <barrier>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#ifndef THREAD_SAFE_STRUCTS_NO_BOOST
+#include "boost/thread/shared_mutex.hpp"
+#include "boost/container/small_vector.hpp"
+#endif
\ No newline at end of file